@@ -1,5 +1,7 @@
 #include <format>
 #include "app.h"
+#include "copy_on_write.h"
+#include "state_writer.h"
 
 namespace app {
 
@@ -22,9 +24,21 @@ model::GameSession::Id Player::GetSessionId() const {
     return session_id_;
 }
 
+std::shared_ptr<model::DogInput> Player::GetInput() const {
+    return input_;
+}
+
+void Player::SetInput(std::shared_ptr<model::DogInput> input) {
+    input_ = std::move(input);
+}
+
 Token Player::GenerateToken() {
     std::random_device rdev;
     std::mt19937_64 gen(rdev());
+    return GenerateToken(gen);
+}
+
+Token Player::GenerateToken(std::mt19937_64& gen) {
     std::uniform_int_distribution<std::mt19937_64::result_type> dist;
     return {std::format("{:0>16x}{:0>16x}", dist(gen), dist(gen))}; // TODO: magic num
 }
@@ -36,28 +50,66 @@ std::shared_ptr<Player> Players::Add(const std::string& dog_name,
                                      model::GameSession::Id sess_id,
                                      std::optional<Player::Id::ValueType> id,
                                      std::optional<Token> token) {
-    auto new_player_id_val = id ? *id : std::max_element(players_map_.begin(), players_map_.end())->first + 1;
-    Player::Id new_player_id{new_player_id_val};
+    Player::Id new_player_id{id ? *id : NextId()};
     auto new_player = std::make_shared<Player>(new_player_id, sess_id, dog_name, token);
-    players_map_.emplace(*new_player_id, new_player);
+    // Новые и восстанавливаемые по порядку id добавляются в конец
+    auto& players_map = util::DetachShared(players_map_);
+    players_map.emplace_hint(players_map.end(), *new_player_id, new_player);
     token_to_player_.emplace(new_player->GetTokenValue(), new_player);
     return new_player;
 }
 
-std::map<Player::Id::ValueType, std::shared_ptr<Player>> Players::GetPlayers() const {
+std::vector<std::shared_ptr<Player>> Players::AddBatch(
+        const std::vector<std::pair<std::string, model::GameSession::Id>>& joins) {
+    std::random_device rdev;
+    std::mt19937_64 gen(rdev());
+
+    std::vector<std::shared_ptr<Player>> added;
+    added.reserve(joins.size());
+    token_to_player_.reserve(token_to_player_.size() + joins.size());
+
+    auto id_val = NextId();
+    auto& players_map = util::DetachShared(players_map_);
+    for (const auto& [dog_name, sess_id] : joins) {
+        auto player = std::make_shared<Player>(Player::Id{id_val++}, sess_id, dog_name, Player::GenerateToken(gen));
+        players_map.emplace_hint(players_map.end(), player->GetIdValue(), player);
+        token_to_player_.emplace(player->GetTokenValue(), player);
+        added.emplace_back(std::move(player));
+    }
+    return added;
+}
+
+void Players::Reserve(size_t count) {
+    token_to_player_.reserve(count);
+}
+
+Player::Id::ValueType Players::NextId() const {
+    return players_map_->empty() ? 0 : players_map_->rbegin()->first + 1;
+}
+
+Players::PlayerMap Players::GetPlayers() const {
+    return *players_map_;
+}
+
+std::shared_ptr<const Players::PlayerMap> Players::GetSnapshot() const {
     return players_map_;
 }
 
 std::optional<std::shared_ptr<Player>> Players::GetPlayer(std::string_view token) const {
-    if (token_to_player_.find(Token{token}) == token_to_player_.end()) {
-        return std::nullopt;
+    if (auto it = token_to_player_.find(Token{token}); it != token_to_player_.end()) {
+        return it->second;
     }
-    return token_to_player_.at(Token{token});
+    return std::nullopt;
+}
+
+bool Players::HasPlayer(Player::Id::ValueType id) const {
+    return players_map_->contains(id);
 }
 
 void Players::DeletePlayer(Player::Id::ValueType id) {
-    token_to_player_.erase(players_map_.at(id)->GetTokenValue());
-    players_map_.erase(id);
+    auto& players_map = util::DetachShared(players_map_);
+    token_to_player_.erase(players_map.at(id)->GetTokenValue());
+    players_map.erase(id);
 }
 
 /*
@@ -67,15 +119,63 @@ std::shared_ptr<model::Game> App::GetGame() const {
     return game_;
 }
 
-std::pair<uint64_t, std::string> App::JoinGame(const std::string& username, model::Map& map) {
+JoinResult App::JoinGame(const std::string& username, const model::Map& map) {
     auto session = game_->GetSession(map);
     auto sess_id = model::GameSession::Id{session->GetIdValue()};
+    std::unique_lock lock{players_mutex_};
     auto player = players_.Add(username, sess_id);
     session->AddDog(player->GetIdValue(), username);
+    player->SetInput(session->GetDogInput(player->GetIdValue()));
+    if (track_player_changes_) {
+        player_changes_.joined.push_back(player);
+    }
     return {player->GetIdValue(), player->GetTokenValue()};
 }
 
+std::vector<JoinResult> App::JoinGameBatch(const std::vector<JoinRequest>& joins) {
+    // Сессия ищется один раз на каждую карту из пачки
+    std::unordered_map<const model::Map*, std::shared_ptr<model::GameSession>> map_sessions;
+    std::vector<std::pair<std::string, model::GameSession::Id>> player_joins;
+    player_joins.reserve(joins.size());
+    for (const auto& [user_name, map] : joins) {
+        auto [it, inserted] = map_sessions.try_emplace(map);
+        if (inserted) {
+            it->second = game_->GetSession(*map);
+        }
+        player_joins.emplace_back(user_name, model::GameSession::Id{it->second->GetIdValue()});
+    }
+
+    std::unique_lock lock{players_mutex_};
+    auto players = players_.AddBatch(player_joins);
+
+    std::unordered_map<model::GameSession::Id::ValueType, std::vector<std::pair<model::Dog::Id::ValueType, std::string>>> session_dogs;
+    std::vector<JoinResult> result;
+    result.reserve(players.size());
+    for (const auto& player : players) {
+        session_dogs[*player->GetSessionId()].emplace_back(player->GetIdValue(), player->GetDogName());
+        result.emplace_back(player->GetIdValue(), player->GetTokenValue());
+    }
+
+    for (const auto& [map, session] : map_sessions) {
+        session->AddDogs(session_dogs.at(session->GetIdValue()));
+    }
+    LinkInputs(players);
+    if (track_player_changes_) {
+        player_changes_.joined.insert(player_changes_.joined.end(), players.begin(), players.end());
+    }
+    return result;
+}
+
+void App::LinkInputs(const std::vector<std::shared_ptr<Player>>& players) const {
+    for (const auto& player : players) {
+        if (auto session = game_->FindSession(player->GetSessionId())) {
+            player->SetInput(session->GetDogInput(player->GetIdValue()));
+        }
+    }
+}
+
 std::optional<std::shared_ptr<Player>> App::GetPlayer(std::string_view token) const {
+    std::shared_lock lock{players_mutex_};
     return players_.GetPlayer(token);
 }
 
@@ -83,10 +183,49 @@ Players App::GetPlayers() const {
     return players_;
 }
 
+std::shared_ptr<const Players::PlayerMap> App::GetPlayersSnapshot() const {
+    std::shared_lock lock{players_mutex_};
+    return players_.GetSnapshot();
+}
+
 void App::RestorePlayers(const Players& players) {
+    std::vector<std::shared_ptr<Player>> restored;
+    for (const auto& [id, player] : players.GetPlayers()) {
+        restored.push_back(player);
+    }
+    LinkInputs(restored);
+
+    std::unique_lock lock{players_mutex_};
     players_ = players;
 }
 
+void App::ApplyPlayerChanges(const PlayerChanges& changes) {
+    std::vector<std::shared_ptr<Player>> joined;
+    {
+        std::unique_lock lock{players_mutex_};
+        for (auto id : changes.left) {
+            if (players_.HasPlayer(id)) {
+                players_.DeletePlayer(id);
+            }
+        }
+        for (const auto& player : changes.joined) {
+            joined.push_back(players_.Add(player->GetDogName(), player->GetSessionId(),
+                                          player->GetIdValue(), player->GetTokenValue()));
+        }
+    }
+    LinkInputs(joined);
+}
+
+void App::TrackPlayerChanges() {
+    std::unique_lock lock{players_mutex_};
+    track_player_changes_ = true;
+}
+
+PlayerChanges App::TakePlayerChanges() {
+    std::unique_lock lock{players_mutex_};
+    return std::exchange(player_changes_, {});
+}
+
 std::map<std::string, std::string> App::GetPlayersInfo() const {
     std::map<std::string, std::string> players_info;
     for (const auto& [id, player] : players_.GetPlayers()) {
@@ -95,43 +234,90 @@ std::map<std::string, std::string> App::GetPlayersInfo() const {
     return players_info;
 }
 
-model::GameState App::GetGameState(std::string_view token) const {
-    std::map<std::string, model::Dog> dogs;
-    auto player_ptr = *players_.GetPlayer(token);
-    auto session = game_->GetSessions().at(*player_ptr->GetSessionId());
-    for (const auto& dog : session->GetDogs()) {
-        dogs.emplace(std::to_string(dog.GetIdValue()), dog);
+std::shared_ptr<model::GameSession> App::GetPlayerSession(std::string_view token) const {
+    auto player = GetPlayer(token);
+    if (!player) {
+        return nullptr;
+    }
+    return game_->FindSession((*player)->GetSessionId());
+}
+
+bool App::WriteGameState(std::string_view token, std::string& out) const {
+    auto player = GetPlayer(token);
+    if (!player) {
+        return false;
+    }
+    auto session = game_->FindSession((*player)->GetSessionId());
+    if (!session) {
+        return false;
+    }
+    // Собака игрока имеет его id
+    model::WriteGameState(*session, (*player)->GetIdValue(), out);
+    return true;
+}
+
+bool App::WriteGameStateChanges(std::string_view token, uint64_t since, std::string& out) const {
+    auto player = GetPlayer(token);
+    if (!player) {
+        return false;
+    }
+    auto session = game_->FindSession((*player)->GetSessionId());
+    if (!session) {
+        return false;
+    }
+    model::WriteGameStateChanges(*session, (*player)->GetIdValue(), since, out);
+    return true;
+}
+
+bool App::MovePlayer(std::string_view token, model::Direction direction) {
+    std::shared_lock lock{players_mutex_};
+    auto player = players_.GetPlayer(token);
+    if (!player) {
+        return false;
     }
-    std::map<std::string, model::LootItem> loots;
-    for (const auto& [item_id, item] : session->GetLoots()) {
-        loots.emplace(std::to_string(item_id), item);
+    if (auto input = (*player)->GetInput()) {
+        input->Post(direction);
     }
-    return {dogs, loots};
+    return true;
 }
 
 void App::RetireDogs() {
     auto retirement_time = GetGame()->GetRetirementTime();
-    for (auto & [sess_id, sess_ptr] : GetGame()->GetSessions()) {
-        std::vector<model::Dog::Id::ValueType> retired_dog_ids;
-        for (const auto &dog : sess_ptr->GetDogs()) {
-            if (dog.GetNonactiveTime() >= retirement_time) {
-                db_.Save({
-                                 dog.GetName(),
-                                 dog.GetScore(),
-                                 dog.GetPlayTime()
-                         });
-                retired_dog_ids.push_back(dog.GetIdValue());
-            }
+    domain::Retirees retirees;
+    for (const auto& [sess_id, sess_ptr] : GetGame()->GetSessions()) {
+        // Сессия отдаёт только тех, чей срок вышел, не перебирая остальных
+        auto retired = sess_ptr->TakeRetiredDogs(retirement_time);
+        if (retired.empty()) {
+            continue;
         }
-        for (auto id : retired_dog_ids) {
-            sess_ptr->RemoveDog(id);
+        std::unique_lock lock{players_mutex_};
+        for (const auto& dog : retired) {
+            const auto id = dog.GetIdValue();
+            retirees.push_back({
+                             dog.GetName(),
+                             dog.GetScore(),
+                             dog.GetPlayTime()
+                     });
             players_.DeletePlayer(id);
+            if (track_player_changes_) {
+                // Вошедший и вышедший между чтениями игрок в журнал не попадает
+                std::erase_if(player_changes_.joined, [id](const auto& player) {
+                    return player->GetIdValue() == id;
+                });
+                player_changes_.left.push_back(id);
+            }
         }
     }
+    if (retirees.empty()) {
+        return;
+    }
+    top_records_.Add(retirees);
+    // Запись в БД идёт в фоновом потоке и не задерживает тик
+    records_writer_.Save(std::move(retirees));
 }
 
-domain::Retirees App::GetRetiredDogs(std::optional<int> start, std::optional<int> max_items) const {
-    return db_.GetRetiredDogs(start, max_items);
+void App::WarmUpRecords(size_t cache_size) {
+    top_records_.Warm(records_.GetRetiredDogs({0, std::nullopt, static_cast<int>(cache_size)}), cache_size);
 }
 
 } // namespace app
\ No newline at end of file
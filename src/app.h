@@ -5,12 +5,20 @@
 #include <map>
 #include <memory>
 #include <random>
+#include <shared_mutex>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
 #include "model.h"
 
 #include "domain.h"
-#include "db.h"
+#include "record_store.h"
+#include "leaderboard.h"
 
 namespace app {
 
@@ -35,6 +43,10 @@ public:
     [[nodiscard]] Id::ValueType GetIdValue() const;
     [[nodiscard]] std::string GetDogName() const;
     [[nodiscard]] model::GameSession::Id GetSessionId() const;
+    [[nodiscard]] std::shared_ptr<model::DogInput> GetInput() const;
+    void SetInput(std::shared_ptr<model::DogInput> input);
+    // Генерирует токен из переданного генератора - для пакетного создания игроков
+    static Token GenerateToken(std::mt19937_64& gen);
 private:
     static Token GenerateToken();
 private:
@@ -42,42 +54,123 @@ private:
     model::GameSession::Id session_id_;
     std::string dog_name_;
     Token token_;
+    std::shared_ptr<model::DogInput> input_;
 };
 
 class Players {
 public:
+    using PlayerMap = std::map<Player::Id::ValueType, std::shared_ptr<Player>>;
+
     std::shared_ptr<Player> Add(const std::string& dog_name,
                                 model::GameSession::Id sess_id,
                                 std::optional<Player::Id::ValueType> id = std::nullopt,
                                 std::optional<Token> token = std::nullopt);
-    [[nodiscard]] std::map<Player::Id::ValueType, std::shared_ptr<Player>> GetPlayers() const;
+    // Добавляет игроков пачкой: id выделяются подряд, токены - одним генератором
+    std::vector<std::shared_ptr<Player>> AddBatch(const std::vector<std::pair<std::string, model::GameSession::Id>>& joins);
+    void Reserve(size_t count);
+    [[nodiscard]] PlayerMap GetPlayers() const;
+    // Без копирования: игроки делятся со снимком, Players скопирует их при следующем изменении
+    [[nodiscard]] std::shared_ptr<const PlayerMap> GetSnapshot() const;
     [[nodiscard]] std::optional<std::shared_ptr<Player>> GetPlayer(std::string_view token) const;
+    [[nodiscard]] bool HasPlayer(Player::Id::ValueType id) const;
     void DeletePlayer(Player::Id::ValueType id);
 private:
-    std::map<Player::Id::ValueType, std::shared_ptr<Player>> players_map_;
+    [[nodiscard]] Player::Id::ValueType NextId() const;
+private:
+    // Копируется при записи, см. util::DetachShared
+    std::shared_ptr<PlayerMap> players_map_ = std::make_shared<PlayerMap>();
     std::unordered_map<Token, std::shared_ptr<Player>> token_to_player_;
 };
 
+struct JoinRequest {
+    std::string user_name;
+    const model::Map* map;
+};
+
+using JoinResult = std::pair<uint64_t, std::string>;
+
+// Игроки, вошедшие и вышедшие с прошлого TakePlayerChanges
+struct PlayerChanges {
+    std::vector<std::shared_ptr<Player>> joined;
+    std::vector<Player::Id::ValueType> left;
+};
+
 class App {
 public:
-    explicit App(std::shared_ptr<model::Game> game, db::RecordDB& db)
+    explicit App(std::shared_ptr<model::Game> game, db::RecordStore& records, db::RecordWriter& records_writer)
         : game_(std::move(game))
-        , db_{db} {
+        , records_{records}
+        , records_writer_{records_writer} {
     }
 public:
     [[nodiscard]] std::shared_ptr<model::Game> GetGame() const;
-    [[nodiscard]] std::pair<uint64_t, std::string> JoinGame(const std::string& username, model::Map& map);
+    [[nodiscard]] JoinResult JoinGame(const std::string& username, const model::Map& map);
+    [[nodiscard]] std::vector<JoinResult> JoinGameBatch(const std::vector<JoinRequest>& joins);
     [[nodiscard]] std::optional<std::shared_ptr<Player>> GetPlayer(std::string_view token) const;
     [[nodiscard]] Players GetPlayers() const;
+    [[nodiscard]] std::shared_ptr<const Players::PlayerMap> GetPlayersSnapshot() const;
     void RestorePlayers(const Players& players);
+    // Применяет изменения из журнала: сначала выходы, потом входы
+    void ApplyPlayerChanges(const PlayerChanges& changes);
+    // Включает накопление изменений для TakePlayerChanges
+    void TrackPlayerChanges();
+    [[nodiscard]] PlayerChanges TakePlayerChanges();
     [[nodiscard]] std::map<std::string, std::string> GetPlayersInfo() const;
-    [[nodiscard]] model::GameState GetGameState(std::string_view token) const;
+    // Сессия игрока; nullptr, если токен неизвестен
+    [[nodiscard]] std::shared_ptr<model::GameSession> GetPlayerSession(std::string_view token) const;
+    // Дописывает в out состояние сессии, видимое игроку; false, если токен неизвестен
+    bool WriteGameState(std::string_view token, std::string& out) const;
+    // То же для изменений с версии since, см. model::WriteGameStateChanges; полное состояние - видимое игроку
+    bool WriteGameStateChanges(std::string_view token, uint64_t since, std::string& out) const;
+    // Потокобезопасен: только кладёт направление в ящик ввода собаки, применится оно на следующем тике.
+    // false, если игрок с таким токеном не найден
+    bool MovePlayer(std::string_view token, model::Direction direction);
     void RetireDogs();
-    [[nodiscard]] domain::Retirees GetRetiredDogs(std::optional<int> start, std::optional<int> max_items) const;
+    // Заполняет кэш лучших рекордов из БД, вызывается на старте
+    void WarmUpRecords(size_t cache_size);
+
+    /*
+     * Сигнатура завершения void(std::exception_ptr, domain::Retirees).
+     * Первые страницы отдаются из памяти, за остальными идём в хранилище рекордов;
+     * одновременные запросы одной и той же страницы сливаются в один запрос
+     */
+    template <typename CompletionToken>
+    auto AsyncGetRetiredDogs(domain::RecordsQuery query, CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(std::exception_ptr, domain::Retirees)>(
+            [this, query = std::move(query)](auto handler) {
+                auto work = net::make_work_guard(net::get_associated_executor(handler));
+                auto deliver = [handler = std::move(handler), work](std::exception_ptr error, domain::Retirees records) mutable {
+                    net::post(work.get_executor(), [handler = std::move(handler), error, records = std::move(records)]() mutable {
+                        handler(error, std::move(records));
+                    });
+                };
+
+                if (auto page = top_records_.GetPage(query)) {
+                    return deliver(nullptr, std::move(*page));
+                }
+
+                if (records_flights_.Join(query, std::move(deliver))) {
+                    records_.AsyncGetRetiredDogs(query, net::bind_executor(records_.GetExecutor(),
+                        [this, query](std::exception_ptr error, domain::Retirees records) {
+                            records_flights_.Complete(query, error, records);
+                        }));
+                }
+            }, token);
+    }
+private:
+    void LinkInputs(const std::vector<std::shared_ptr<Player>>& players) const;
 private:
     std::shared_ptr<model::Game> game_;
+    // Изменяется только из strand'а симуляции, читается также из потоков ввода-вывода
+    mutable std::shared_mutex players_mutex_;
     Players players_;
-    db::RecordDB& db_;
+    bool track_player_changes_ = false;
+    PlayerChanges player_changes_;
+    db::RecordStore& records_;
+    db::RecordWriter& records_writer_;
+
+    leaderboard::TopRecords top_records_;
+    leaderboard::SingleFlight<domain::RecordsQuery, domain::Retirees> records_flights_;
 };
 
 } // namespace app
@@ -0,0 +1,248 @@
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/crc.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
+#include <boost/serialization/string.hpp>
+
+#include "config_cache.h"
+
+namespace json_loader {
+
+namespace fs = std::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'G', 'S', 'C', 'F', 'G', 'C', 'C', 'H'};
+
+uint32_t Checksum(const char* data, size_t size) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+// Необязательное поле: флаг наличия, затем значение
+template <typename T>
+void SaveOptional(boost::archive::binary_oarchive& ar, const std::optional<T>& value) {
+    const bool has_value = value.has_value();
+    ar << has_value;
+    if (has_value) {
+        ar << *value;
+    }
+}
+
+template <typename T>
+void LoadOptional(boost::archive::binary_iarchive& ar, std::optional<T>& value) {
+    bool has_value = false;
+    ar >> has_value;
+    if (has_value) {
+        ar >> value.emplace();
+    } else {
+        value.reset();
+    }
+}
+
+void SaveLoot(boost::archive::binary_oarchive& ar, const loot::LootType& loot) {
+    ar << loot.name << loot.file << loot.type;
+    SaveOptional(ar, loot.rotation);
+    SaveOptional(ar, loot.color);
+    SaveOptional(ar, loot.scale);
+    SaveOptional(ar, loot.value);
+}
+
+loot::LootType LoadLoot(boost::archive::binary_iarchive& ar) {
+    loot::LootType loot;
+    ar >> loot.name >> loot.file >> loot.type;
+    LoadOptional(ar, loot.rotation);
+    LoadOptional(ar, loot.color);
+    LoadOptional(ar, loot.scale);
+    LoadOptional(ar, loot.value);
+    return loot;
+}
+
+void SaveMap(boost::archive::binary_oarchive& ar, const model::Map& map, const loot::MapLootTypes& loots) {
+    ar << *map.GetId() << map.GetName() << map.GetSpeed() << static_cast<uint64_t>(map.GetBagSize());
+    SaveOptional(ar, map.GetViewRadius());
+
+    ar << static_cast<uint64_t>(map.GetRoads().size());
+    for (const auto& road : map.GetRoads()) {
+        ar << road.GetStart().x << road.GetStart().y << road.GetEnd().x << road.GetEnd().y;
+    }
+    ar << static_cast<uint64_t>(map.GetBuildings().size());
+    for (const auto& building : map.GetBuildings()) {
+        const auto bounds = building.GetBounds();
+        ar << bounds.position.x << bounds.position.y << bounds.size.width << bounds.size.height;
+    }
+    ar << static_cast<uint64_t>(map.GetOffices().size());
+    for (const auto& office : map.GetOffices()) {
+        ar << *office.GetId() << office.GetPosition().x << office.GetPosition().y
+           << office.GetOffset().dx << office.GetOffset().dy;
+    }
+    ar << static_cast<uint64_t>(loots.size());
+    for (const auto& loot : loots) {
+        SaveLoot(ar, loot);
+    }
+}
+
+// Элементы сразу добавляются в карту, промежуточных векторов нет
+std::pair<model::Map, loot::MapLootTypes> LoadMap(boost::archive::binary_iarchive& ar) {
+    std::string id;
+    std::string name;
+    double speed = 0.0;
+    uint64_t bag_size = 0;
+    ar >> id >> name >> speed >> bag_size;
+    model::Map map{model::Map::Id{std::move(id)}, std::move(name)};
+    map.SetSpeed(speed);
+    map.SetBagSize(bag_size);
+    std::optional<double> view_radius;
+    LoadOptional(ar, view_radius);
+    map.SetViewRadius(view_radius);
+
+    uint64_t count = 0;
+    ar >> count;
+    for (uint64_t i = 0; i < count; ++i) {
+        model::Point start{};
+        model::Point end{};
+        ar >> start.x >> start.y >> end.x >> end.y;
+        map.AddRoad(model::Road{start, end});
+    }
+    ar >> count;
+    for (uint64_t i = 0; i < count; ++i) {
+        model::Rectangle bounds{};
+        ar >> bounds.position.x >> bounds.position.y >> bounds.size.width >> bounds.size.height;
+        map.AddBuilding(model::Building{bounds});
+    }
+    ar >> count;
+    for (uint64_t i = 0; i < count; ++i) {
+        std::string office_id;
+        model::Point position{};
+        model::Offset offset{};
+        ar >> office_id >> position.x >> position.y >> offset.dx >> offset.dy;
+        map.AddOffice(model::Office{model::Office::Id{std::move(office_id)}, position, offset});
+    }
+    ar >> count;
+    loot::MapLootTypes loots;
+    loots.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        loots.push_back(LoadLoot(ar));
+    }
+    return {std::move(map), std::move(loots)};
+}
+
+} // namespace
+
+void GameSettings::ApplyTo(model::Game& game) const {
+    game.SetDefaultSpeed(default_speed);
+    game.SetDefaultBagSize(default_bag_size);
+    game.SetLootGenerator(std::make_shared<loot::LootGenerator>(std::chrono::milliseconds{loot_period_ms},
+                                                                loot_probability));
+    game.SetRetirementTime(retirement_time);
+}
+
+ConfigCache::Key ConfigCache::MakeKey(const fs::path& config_path) {
+    const auto size = fs::file_size(config_path);
+    if (size == 0) {
+        return {};
+    }
+    bip::file_mapping mapping{config_path.c_str(), bip::read_only};
+    bip::mapped_region region{mapping, bip::read_only};
+    return {size, Checksum(static_cast<const char*>(region.get_address()), region.get_size())};
+}
+
+std::shared_ptr<model::Game> ConfigCache::Load(const fs::path& cache_path, const Key& key) {
+    std::error_code ec;
+    const auto size = fs::file_size(cache_path, ec);
+    if (ec || size < sizeof(Header)) {
+        return nullptr;
+    }
+
+    bip::file_mapping mapping{cache_path.c_str(), bip::read_only};
+    bip::mapped_region region{mapping, bip::read_only};
+    const auto* data = static_cast<const char*>(region.get_address());
+
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    if (header.magic != MAGIC) {
+        throw std::runtime_error("Not a config cache");
+    }
+    // Кэш другой версии или от другого конфига - просто промах
+    if (header.format_version != FORMAT_VERSION || Key{header.config_size, header.config_checksum} != key) {
+        return nullptr;
+    }
+    if (header.header_size < sizeof(Header) || header.header_size + header.body_size != region.get_size()) {
+        throw std::runtime_error("Config cache is truncated");
+    }
+    const char* body = data + header.header_size;
+    if (Checksum(body, header.body_size) != header.body_checksum) {
+        throw std::runtime_error("Config cache checksum mismatch");
+    }
+
+    // Архив читает прямо из отображённой памяти
+    bip::ibufferstream stream{body, header.body_size};
+    boost::archive::binary_iarchive ar(static_cast<std::istream&>(stream), boost::archive::no_header);
+
+    GameSettings settings;
+    ar >> settings.default_speed >> settings.default_bag_size >> settings.loot_period_ms
+       >> settings.loot_probability >> settings.retirement_time;
+    auto game = std::make_shared<model::Game>();
+    settings.ApplyTo(*game);
+
+    uint64_t map_count = 0;
+    ar >> map_count;
+    auto table = std::make_shared<model::MapTable>();
+    table->maps.reserve(map_count);
+    for (uint64_t i = 0; i < map_count; ++i) {
+        auto [map, loots] = LoadMap(ar);
+        table->loot_data.emplace(map.GetId(), std::move(loots));
+        table->Add(std::move(map));
+    }
+    game->SetMapTable(std::move(table));
+    return game;
+}
+
+void ConfigCache::Write(const fs::path& cache_path, const Key& key,
+                        const GameSettings& settings, const model::Game& game) {
+    std::ostringstream body_stream;
+    {
+        boost::archive::binary_oarchive ar(body_stream, boost::archive::no_header);
+        ar << settings.default_speed << settings.default_bag_size << settings.loot_period_ms
+           << settings.loot_probability << settings.retirement_time;
+        const auto table = game.GetMapTable();
+        ar << static_cast<uint64_t>(table->maps.size());
+        for (const auto& map : table->maps) {
+            SaveMap(ar, *map, table->loot_data.at(map->GetId()));
+        }
+    }
+    const auto body = body_stream.str();
+
+    Header header;
+    header.magic = MAGIC;
+    header.format_version = FORMAT_VERSION;
+    header.header_size = sizeof(Header);
+    header.config_size = key.config_size;
+    header.config_checksum = key.config_checksum;
+    header.body_checksum = Checksum(body.data(), body.size());
+    header.body_size = body.size();
+
+    // Запись во временный файл: после rename кэш либо старый, либо целый новый
+    const fs::path tmp_path{cache_path.string() + ".tmp"};
+    {
+        std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(body.data(), static_cast<std::streamsize>(body.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write config cache: " + tmp_path.string());
+        }
+    }
+    fs::rename(tmp_path, cache_path);
+}
+
+}  // namespace json_loader
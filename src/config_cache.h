@@ -0,0 +1,62 @@
+#ifndef GAME_SERVER_CONFIG_CACHE_H
+#define GAME_SERVER_CONFIG_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+
+#include "model.h"
+
+namespace json_loader {
+
+// Общие для всех карт настройки игры из конфига
+struct GameSettings {
+    double default_speed = 0.0;
+    uint64_t default_bag_size = 3;
+    int64_t loot_period_ms = 0;
+    double loot_probability = 0.0;
+    double retirement_time = 60.0;
+
+    void ApplyTo(model::Game& game) const;
+};
+
+/*
+ * Скомпилированный конфиг: настройки и карты в двоичном виде.
+ * Ключ - размер и CRC32 исходного json; кэш от другого конфига не используется.
+ * Файл отображается в память и читается без разбора json.
+ */
+class ConfigCache {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    struct Key {
+        uint64_t config_size = 0;
+        uint32_t config_checksum = 0;
+
+        [[nodiscard]] bool operator==(const Key&) const = default;
+    };
+
+    struct Header {
+        std::array<char, 8> magic{};
+        uint32_t format_version = 0;
+        uint32_t header_size = 0;
+        uint64_t config_size = 0;
+        uint32_t config_checksum = 0;
+        uint32_t body_checksum = 0;
+        uint64_t body_size = 0;
+    };
+
+    [[nodiscard]] static Key MakeKey(const std::filesystem::path& config_path);
+    // nullptr, если кэша нет или он от другого конфига; бросает исключение, если кэш повреждён
+    [[nodiscard]] static std::shared_ptr<model::Game> Load(const std::filesystem::path& cache_path, const Key& key);
+    static void Write(const std::filesystem::path& cache_path, const Key& key,
+                      const GameSettings& settings, const model::Game& game);
+};
+
+static_assert(std::is_trivially_copyable_v<ConfigCache::Header> && sizeof(ConfigCache::Header) == 40);
+
+}  // namespace json_loader
+
+#endif //GAME_SERVER_CONFIG_CACHE_H
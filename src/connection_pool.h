@@ -2,28 +2,55 @@
 #define CONNECTION_POOL_H
 
 #include <pqxx/pqxx>
-#include <mutex>
+#include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include "metrics.h"
 
 namespace connection_pool {
 
+namespace net = boost::asio;
+
 class ConnectionPool {
     using PoolType = ConnectionPool;
     using ConnectionPtr = std::shared_ptr<pqxx::connection>;
+    using Clock = std::chrono::steady_clock;
 
 public:
+    // ConnectionFactory открывает новое соединение и готовит на нём prepared statements
+    using ConnectionFactory = std::function<ConnectionPtr()>;
+
     class ConnectionWrapper {
     public:
-        ConnectionWrapper(std::shared_ptr<pqxx::connection>&& conn, PoolType& pool) noexcept
+        ConnectionWrapper(ConnectionPtr&& conn, bool needs_ping, PoolType& pool) noexcept
             : conn_{std::move(conn)}
+            , needs_ping_{needs_ping}
             , pool_{&pool} {
         }
 
         ConnectionWrapper(const ConnectionWrapper&) = delete;
         ConnectionWrapper& operator=(const ConnectionWrapper&) = delete;
 
-        ConnectionWrapper(ConnectionWrapper&&) = default;
-        ConnectionWrapper& operator=(ConnectionWrapper&&) = default;
+        ConnectionWrapper(ConnectionWrapper&& other) noexcept
+            : conn_{std::move(other.conn_)}
+            , needs_ping_{other.needs_ping_}
+            , broken_{other.broken_}
+            , pool_{std::exchange(other.pool_, nullptr)} {
+        }
+        ConnectionWrapper& operator=(ConnectionWrapper&&) = delete;
 
         pqxx::connection& operator*() const& noexcept {
             return *conn_;
@@ -34,56 +61,150 @@ public:
             return conn_.get();
         }
 
+        // Переоткрывает соединение, если оно закрыто или давно простаивало и не отвечает.
+        // Вызывается в потоке, который будет выполнять запросы: может блокировать
+        void EnsureAlive() {
+            if (conn_ && conn_->is_open() && needs_ping_) {
+                try {
+                    pqxx::nontransaction ping{*conn_};
+                    ping.exec("SELECT 1");
+                } catch (const pqxx::broken_connection&) {
+                    conn_.reset();
+                }
+            }
+            needs_ping_ = false;
+            if (!conn_ || !conn_->is_open()) {
+                conn_ = pool_->Reconnect();
+            }
+        }
+
+        // Соединение будет закрыто и открыто заново при следующей выдаче
+        void MarkBroken() noexcept {
+            broken_ = true;
+        }
+
         ~ConnectionWrapper() {
-            if (conn_) {
-                pool_->ReturnConnection(std::move(conn_));
+            if (pool_) {
+                pool_->ReturnConnection(broken_ ? nullptr : std::move(conn_));
             }
         }
 
     private:
-        std::shared_ptr<pqxx::connection> conn_;
+        ConnectionPtr conn_;
+        bool needs_ping_ = false;
+        bool broken_ = false;
         PoolType* pool_;
     };
 
-    // ConnectionFactory is a functional object returning std::shared_ptr<pqxx::connection>
-    template <typename ConnectionFactory>
-    ConnectionPool(size_t capacity, ConnectionFactory&& connection_factory) {
-        pool_.reserve(capacity);
-        for (size_t i = 0; i < capacity; ++i) {
-            pool_.emplace_back(connection_factory());
-        }
+    // Соединения открываются лениво, при первой выдаче
+    ConnectionPool(size_t capacity, ConnectionFactory connection_factory)
+            : connection_factory_{std::move(connection_factory)}
+            , pool_(capacity)
+            , last_used_(capacity, Clock::now()) {
     }
 
+    // Блокирующая выдача соединения - только для фоновых потоков
     ConnectionWrapper GetConnection() {
+        const auto start = Clock::now();
         std::unique_lock lock{mutex_};
         // Блокируем текущий поток и ждём, пока cond_var_ не получит уведомление и не освободится
         // хотя бы одно соединение
         cond_var_.wait(lock, [this] {
-            return used_connections_ < pool_.size();
+            return waiters_.empty() && used_connections_ < pool_.size();
         });
         // После выхода из цикла ожидания мьютекс остаётся захваченным
 
-        return {std::move(pool_[used_connections_++]), *this};
+        wait_ms_.Observe(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        return TakeConnection();
+    }
+
+    /*
+     * Асинхронная выдача соединения, сигнатура завершения void(ConnectionWrapper).
+     * Обработчик вызывается через свой ассоциированный executor;
+     * поток, запросивший соединение, никогда не блокируется.
+     */
+    template <typename CompletionToken>
+    auto AsyncGetConnection(CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(ConnectionWrapper)>(
+            [this](auto handler) {
+                auto executor = net::get_associated_executor(handler);
+                Waiter waiter = [this, start = Clock::now(), work = net::make_work_guard(executor),
+                                 handler = std::move(handler)](ConnectionWrapper conn) mutable {
+                    wait_ms_.Observe(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                    auto executor = work.get_executor();
+                    net::post(executor, [handler = std::move(handler), conn = std::move(conn)]() mutable {
+                        handler(std::move(conn));
+                    });
+                };
+
+                std::unique_lock lock{mutex_};
+                if (used_connections_ < pool_.size()) {
+                    auto conn = TakeConnection();
+                    lock.unlock();
+                    waiter(std::move(conn));
+                } else {
+                    waiters_.push_back(std::move(waiter));
+                }
+            }, token);
     }
 
 private:
+    using Waiter = std::move_only_function<void(ConnectionWrapper)>;
+
+    // Вызывается под захваченным mutex_
+    ConnectionWrapper TakeConnection() {
+        const auto index = used_connections_++;
+        const bool needs_ping = Clock::now() - last_used_[index] > PING_IDLE_INTERVAL;
+        in_use_.Set(static_cast<double>(used_connections_));
+        return {std::move(pool_[index]), needs_ping, *this};
+    }
+
+    ConnectionPtr Reconnect() {
+        reconnects_.Add();
+        return connection_factory_();
+    }
+
     void ReturnConnection(ConnectionPtr&& conn) {
+        Waiter waiter;
+        std::unique_lock lock{mutex_};
+        assert(used_connections_ != 0);
         // Возвращаем соединение обратно в пул
-        {
-            std::lock_guard lock{mutex_};
-            assert(used_connections_ != 0);
-            pool_[--used_connections_] = std::move(conn);
+        --used_connections_;
+        pool_[used_connections_] = std::move(conn);
+        last_used_[used_connections_] = Clock::now();
+
+        if (!waiters_.empty()) {
+            // Асинхронные ожидающие обслуживаются первыми
+            waiter = std::move(waiters_.front());
+            waiters_.pop_front();
+            auto conn_for_waiter = TakeConnection();
+            lock.unlock();
+            waiter(std::move(conn_for_waiter));
+            return;
         }
+
+        in_use_.Set(static_cast<double>(used_connections_));
+        lock.unlock();
         // Уведомляем один из ожидающих потоков об изменении состояния пула
         cond_var_.notify_one();
     }
 
+private:
+    static constexpr auto PING_IDLE_INTERVAL = std::chrono::seconds{30};
+
+    ConnectionFactory connection_factory_;
     std::mutex mutex_;
     std::condition_variable cond_var_;
     std::vector<ConnectionPtr> pool_;
+    std::vector<Clock::time_point> last_used_;
+    std::deque<Waiter> waiters_;
     size_t used_connections_ = 0;
+
+    metrics::Histogram& wait_ms_ = metrics::Registry::get_instance().GetHistogram("db.pool.wait_ms");
+    metrics::Gauge& in_use_ = metrics::Registry::get_instance().GetGauge("db.pool.in_use");
+    metrics::Counter& reconnects_ = metrics::Registry::get_instance().GetCounter("db.pool.reconnects");
 };
 
 } // namespace connection_pool
 
-#endif // CONNECTION_POOL_H
\ No newline at end of file
+#endif // CONNECTION_POOL_H
@@ -0,0 +1,29 @@
+#ifndef GAME_SERVER_COPY_ON_WRITE_H
+#define GAME_SERVER_COPY_ON_WRITE_H
+
+#include <atomic>
+#include <memory>
+
+namespace util {
+
+/*
+ * Готовит разделяемые данные к записи. Владелец меняет данные только через
+ * свой shared_ptr, читатели получают копии указателя (снимки) и только читают.
+ * Пока снимок жив, владелец получает свою копию данных; если снимков больше нет,
+ * данные меняются на месте. Снимки раздаёт только владелец, поэтому после
+ * проверки счётчика новых читателей не появится.
+ */
+template <typename T>
+T& DetachShared(std::shared_ptr<T>& data) {
+    if (data.use_count() > 1) {
+        data = std::make_shared<T>(*data);
+    } else {
+        // Чтение в потоке, отпустившем последний снимок, завершилось до нашей записи
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *data;
+}
+
+} // namespace util
+
+#endif //GAME_SERVER_COPY_ON_WRITE_H
@@ -4,14 +4,56 @@ namespace db {
 
 using pqxx::operator"" _zv;
 
-RecordDB::RecordDB(const std::string& db_url)
-        : conn_pool_{
-        1, //std::thread::hardware_concurrency(), // TODO: fix tests
-        [&db_url](){
-            return std::make_shared<pqxx::connection>(db_url);
-        }} {
-    auto conn = conn_pool_.GetConnection();
-    pqxx::work work{*conn};
+namespace {
+
+constexpr auto INSERT_RECORD = "insert_record"_zv;
+constexpr auto SELECT_RECORDS = "select_records"_zv;
+constexpr auto SELECT_RECORDS_AFTER = "select_records_after"_zv;
+
+std::shared_ptr<pqxx::connection> Connect(const std::string& db_url) {
+    auto conn = std::make_shared<pqxx::connection>(db_url);
+    conn->prepare(
+        INSERT_RECORD,
+        R"(INSERT INTO retired_players (id, name, score, play_time_ms) VALUES (DEFAULT, $1, $2, $3);)"_zv
+    );
+    // NULL в LIMIT и OFFSET означает отсутствие ограничения.
+    // Имена сравниваются побайтово (COLLATE "C"), как и в кэше рекордов
+    conn->prepare(
+        SELECT_RECORDS,
+        R"(SELECT name, score, play_time_ms FROM retired_players
+        ORDER BY score DESC, play_time_ms, name COLLATE "C" LIMIT $1 OFFSET $2;)"_zv
+    );
+    // Начинаем с записей, равных курсору: их первые skip штук уже были отданы.
+    // score <= $1 - граница диапазона по индексу, остальное отсекает только записи с тем же score
+    conn->prepare(
+        SELECT_RECORDS_AFTER,
+        R"(SELECT name, score, play_time_ms FROM retired_players
+        WHERE score <= $1 AND (score < $1 OR (play_time_ms, name COLLATE "C") >= ($2, $3))
+        ORDER BY score DESC, play_time_ms, name COLLATE "C" LIMIT $4;)"_zv
+    );
+    return conn;
+}
+
+// Соединение, на котором случился обрыв, будет переоткрыто при следующей выдаче
+template <typename Fn>
+auto WithConnection(PostgresRecordStore::Connection& conn, Fn&& fn) {
+    conn.EnsureAlive();
+    try {
+        return fn(*conn);
+    } catch (const pqxx::broken_connection&) {
+        conn.MarkBroken();
+        throw;
+    }
+}
+
+} // namespace
+
+PostgresRecordStore::PostgresRecordStore(const std::string& db_url, size_t pool_size)
+        : conn_pool_{pool_size, [db_url] { return Connect(db_url); }}
+        , db_threads_{pool_size} {
+    // Таблица должна существовать до подготовки запросов на соединениях пула
+    pqxx::connection conn{db_url};
+    pqxx::work work{conn};
     work.exec(
         R"(
         CREATE TABLE IF NOT EXISTS retired_players (
@@ -20,42 +62,94 @@ RecordDB::RecordDB(const std::string& db_url)
         score integer,
         play_time_ms integer))"_zv
     );
+    // Покрывающий индекс под порядок выдачи рекордов: страницы читаются index-only scan'ом
+    work.exec(
+        R"(
+        CREATE INDEX IF NOT EXISTS retired_players_rank_idx
+        ON retired_players (score DESC, play_time_ms, name COLLATE "C"))"_zv
+    );
     work.commit();
 }
 
-void RecordDB::Save(const domain::RetiredDog& dog) {
+void PostgresRecordStore::Save(const domain::RetiredDog& dog) {
     auto conn = conn_pool_.GetConnection();
-    pqxx::work work{*conn};
-    auto response = work.exec_params(
-            R"(INSERT INTO retired_players (id, name, score, play_time_ms) VALUES (DEFAULT, $1, $2, $3);)"_zv,
-            dog.name,
-            dog.score,
-            dog.game_duration.count()
-    );
-    work.commit();
+    WithConnection(conn, [&dog](pqxx::connection& c) {
+        pqxx::work work{c};
+        work.exec_prepared(INSERT_RECORD, dog.name, dog.score, dog.game_duration.count());
+        work.commit();
+    });
 }
 
-domain::Retirees RecordDB::GetRetiredDogs(std::optional<int> start, std::optional<int> max_size) {
-    auto conn = conn_pool_.GetConnection();
-    pqxx::work work{*conn};
-    std::string q = "SELECT name, score, play_time_ms FROM retired_players ORDER BY score DESC, play_time_ms, name";
-    if (max_size.has_value()) {
-        q += " LIMIT " + std::to_string(*max_size);
-    }
-    if (start.has_value()) {
-        q += " OFFSET " + std::to_string(*start);
+void PostgresRecordStore::SaveBatch(const domain::Retirees& dogs) {
+    if (dogs.empty()) {
+        return;
     }
-    q += ";";
-
-    std::vector<domain::RetiredDog> result;
-    for (auto& [name, score, time] : work.query<std::string, size_t, size_t>(q)) {
-        domain::RetiredDog ret;
-        ret.name = name;
-        ret.score = score;
-        ret.game_duration = std::chrono::milliseconds(time);
-        result.push_back(ret);
-    }
-    return result;
+    auto conn = conn_pool_.GetConnection();
+    WithConnection(conn, [&dogs](pqxx::connection& c) {
+        pqxx::work work{c};
+        auto stream = pqxx::stream_to::table(work, {"retired_players"}, {"name", "score", "play_time_ms"});
+        for (const auto& dog : dogs) {
+            stream.write_values(dog.name, dog.score, dog.game_duration.count());
+        }
+        stream.complete();
+        work.commit();
+    });
 }
 
-}
\ No newline at end of file
+domain::Retirees PostgresRecordStore::GetRetiredDogs(const domain::RecordsQuery& query) {
+    auto conn = conn_pool_.GetConnection();
+    return QueryRetiredDogs(conn, query);
+}
+
+void PostgresRecordStore::DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) {
+    conn_pool_.AsyncGetConnection(net::bind_executor(db_threads_.get_executor(),
+        [query = std::move(query), callback = std::move(callback)](Connection conn) mutable {
+            std::exception_ptr error;
+            domain::Retirees records;
+            try {
+                records = QueryRetiredDogs(conn, query);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            callback(error, std::move(records));
+        }));
+}
+
+domain::Retirees PostgresRecordStore::QueryRetiredDogs(Connection& conn, const domain::RecordsQuery& query) {
+    return WithConnection(conn, [&query](pqxx::connection& c) {
+        pqxx::read_transaction work{c};
+        pqxx::result rows;
+        if (query.after) {
+            const auto& after = *query.after;
+            std::optional<int64_t> limit;
+            if (query.max_items) {
+                limit = static_cast<int64_t>(*query.max_items) + after.skip;
+            }
+            rows = work.exec_prepared(SELECT_RECORDS_AFTER, after.score, after.game_duration.count(), after.name, limit);
+        } else {
+            rows = work.exec_prepared(SELECT_RECORDS, query.max_items, query.start);
+        }
+
+        std::vector<domain::RetiredDog> result;
+        result.reserve(rows.size());
+        unsigned to_skip = query.after ? query.after->skip : 0;
+        for (const auto& row : rows) {
+            domain::RetiredDog ret;
+            ret.name = row[0].as<std::string>();
+            ret.score = row[1].as<unsigned>();
+            ret.game_duration = std::chrono::milliseconds(row[2].as<int64_t>());
+            if (to_skip > 0 && domain::IsSameRank(ret, *query.after)) {
+                --to_skip;
+                continue;
+            }
+            to_skip = 0;
+            result.push_back(std::move(ret));
+        }
+        if (query.max_items && result.size() > static_cast<size_t>(*query.max_items)) {
+            result.resize(*query.max_items);
+        }
+        return result;
+    });
+}
+
+}
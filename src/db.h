@@ -3,18 +3,38 @@
 
 #include <string>
 
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/thread_pool.hpp>
+
 #include "connection_pool.h"
 #include "domain.h"
+#include "record_store.h"
 
 namespace db {
 
-class RecordDB {
+namespace net = boost::asio;
+
+// Рекорды в PostgreSQL
+class PostgresRecordStore final : public RecordStore {
 public:
-    explicit RecordDB(const std::string& db_url);
+    using Connection = connection_pool::ConnectionPool::ConnectionWrapper;
+
+    PostgresRecordStore(const std::string& db_url, size_t pool_size);
     void Save(const domain::RetiredDog& dog);
-    domain::Retirees GetRetiredDogs(std::optional<int> start, std::optional<int> max_size);
+    // Пишет все записи одной транзакцией через COPY
+    void SaveBatch(const domain::Retirees& dogs) override;
+    domain::Retirees GetRetiredDogs(const domain::RecordsQuery& query) override;
+    [[nodiscard]] net::any_io_executor GetExecutor() override {
+        return db_threads_.get_executor();
+    }
+protected:
+    // Запрос выполняется на собственных потоках БД
+    void DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) override;
+private:
+    static domain::Retirees QueryRetiredDogs(Connection& conn, const domain::RecordsQuery& query);
 private:
     connection_pool::ConnectionPool conn_pool_;
+    net::thread_pool db_threads_;
 };
 
 } // namespace db
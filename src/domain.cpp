@@ -1,3 +1,7 @@
+#include <charconv>
+#include <cstdint>
+#include <tuple>
+
 #include "domain.h"
 
 namespace domain {
@@ -12,4 +16,83 @@ void tag_invoke(boost::json::value_from_tag, boost::json::value &val, const Reti
     };
 }
 
-}
\ No newline at end of file
+bool RecordOrder::operator()(const RetiredDog& lhs, const RetiredDog& rhs) const {
+    return std::forward_as_tuple(rhs.score, lhs.game_duration, lhs.name)
+           < std::forward_as_tuple(lhs.score, rhs.game_duration, rhs.name);
+}
+
+bool IsSameRank(const RetiredDog& dog, const RecordsCursor& cursor) {
+    return dog.score == cursor.score && dog.game_duration == cursor.game_duration && dog.name == cursor.name;
+}
+
+namespace {
+
+constexpr char CURSOR_SEPARATOR = '-';
+constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+template <typename T>
+std::optional<T> ParseNumber(std::string_view& str) {
+    T value{};
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{} || ptr == str.data() || ptr == str.data() + str.size() || *ptr != CURSOR_SEPARATOR) {
+        return std::nullopt;
+    }
+    str.remove_prefix(ptr - str.data() + 1);
+    return value;
+}
+
+} // namespace
+
+// Формат: score-play_time_ms-skip-hex(name)
+std::string EncodeCursor(const RecordsCursor& cursor) {
+    std::string result = std::to_string(cursor.score) + CURSOR_SEPARATOR
+                         + std::to_string(cursor.game_duration.count()) + CURSOR_SEPARATOR
+                         + std::to_string(cursor.skip) + CURSOR_SEPARATOR;
+    result.reserve(result.size() + cursor.name.size() * 2);
+    for (const unsigned char c : cursor.name) {
+        result += HEX_DIGITS[c >> 4];
+        result += HEX_DIGITS[c & 0xF];
+    }
+    return result;
+}
+
+std::optional<RecordsCursor> DecodeCursor(std::string_view str) {
+    const auto score = ParseNumber<unsigned>(str);
+    const auto play_time = score ? ParseNumber<int64_t>(str) : std::nullopt;
+    const auto skip = play_time ? ParseNumber<unsigned>(str) : std::nullopt;
+    if (!skip || str.size() % 2 != 0) {
+        return std::nullopt;
+    }
+
+    RecordsCursor cursor{*score, std::chrono::milliseconds{*play_time}, {}, *skip};
+    cursor.name.reserve(str.size() / 2);
+    for (size_t i = 0; i < str.size(); i += 2) {
+        const auto high = HEX_DIGITS.find(str[i]);
+        const auto low = HEX_DIGITS.find(str[i + 1]);
+        if (high == std::string_view::npos || low == std::string_view::npos) {
+            return std::nullopt;
+        }
+        cursor.name += static_cast<char>(high << 4 | low);
+    }
+    return cursor;
+}
+
+std::optional<RecordsCursor> NextCursor(const Retirees& page, const std::optional<RecordsCursor>& after) {
+    if (page.empty()) {
+        return std::nullopt;
+    }
+
+    const auto& last = page.back();
+    RecordsCursor cursor{last.score, last.game_duration, last.name, 0};
+    auto it = page.rbegin();
+    for (; it != page.rend() && IsSameRank(*it, cursor); ++it) {
+        ++cursor.skip;
+    }
+    // Вся страница состоит из одинаковых записей - учитываем отданные до неё
+    if (it == page.rend() && after && IsSameRank(last, *after)) {
+        cursor.skip += after->skip;
+    }
+    return cursor;
+}
+
+}
@@ -2,7 +2,10 @@
 #define GAME_SERVER_DB_DOMAIN_H
 
 #include <chrono>
+#include <compare>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <boost/json.hpp>
@@ -17,6 +20,40 @@ struct RetiredDog {
 
 using Retirees = std::vector<domain::RetiredDog>;
 
+// Порядок выдачи рекордов: score DESC, play_time_ms, name (побайтово)
+struct RecordOrder {
+    bool operator()(const RetiredDog& lhs, const RetiredDog& rhs) const;
+};
+
+/*
+ * Позиция для постраничного обхода рекордов: последняя отданная запись
+ * и сколько записей с точно такими же score, временем и именем уже отдано
+ */
+struct RecordsCursor {
+    unsigned score = 0;
+    std::chrono::milliseconds game_duration{};
+    std::string name;
+    unsigned skip = 0;
+
+    auto operator<=>(const RecordsCursor&) const = default;
+};
+
+[[nodiscard]] bool IsSameRank(const RetiredDog& dog, const RecordsCursor& cursor);
+// Курсор передаётся в URL, поэтому кодируется только символами [0-9a-f-]
+[[nodiscard]] std::string EncodeCursor(const RecordsCursor& cursor);
+[[nodiscard]] std::optional<RecordsCursor> DecodeCursor(std::string_view str);
+// Курсор на позицию после page, если page начинается сразу за after (или с начала таблицы)
+[[nodiscard]] std::optional<RecordsCursor> NextCursor(const Retirees& page, const std::optional<RecordsCursor>& after);
+
+// Страница таблицы рекордов: либо по смещению start, либо после курсора after
+struct RecordsQuery {
+    std::optional<int> start;
+    std::optional<RecordsCursor> after;
+    std::optional<int> max_items;
+
+    auto operator<=>(const RecordsQuery&) const = default;
+};
+
 void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const RetiredDog& dog);
 
 }  // namespace domain
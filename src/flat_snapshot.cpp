@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include <boost/crc.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "flat_snapshot.h"
+
+namespace serialization {
+
+namespace fs = std::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC{'G', 'S', 'S', 'N', 'A', 'P', 'F', 'L'};
+constexpr uint64_t ALIGNMENT = 8;
+// Заголовок версий 1 и 2
+constexpr size_t MIN_HEADER_SIZE = offsetof(FlatSnapshot::Header, next_session_id);
+
+uint64_t Align(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+uint32_t Checksum(const char* data, size_t size) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+// Контрольная сумма заголовка считается с обнулённым полем header_checksum
+uint32_t HeaderChecksum(const char* data, size_t header_size) {
+    std::string header{data, header_size};
+    constexpr auto checksum_offset = offsetof(FlatSnapshot::Header, header_checksum);
+    std::memset(header.data() + checksum_offset, 0, sizeof(uint32_t));
+    return Checksum(header.data(), header.size());
+}
+
+// Одинаковые строки (имя собаки и игрока, id карты) хранятся один раз
+class StringTable {
+public:
+    FlatSnapshot::StringRef Add(const std::string& str) {
+        auto [it, inserted] = refs_.try_emplace(str);
+        if (inserted) {
+            if (data_.size() + str.size() > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("Snapshot string table overflow");
+            }
+            it->second = {static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(str.size())};
+            data_ += str;
+        }
+        return it->second;
+    }
+
+    [[nodiscard]] const std::string& GetData() const {
+        return data_;
+    }
+private:
+    std::string data_;
+    std::unordered_map<std::string, FlatSnapshot::StringRef> refs_;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size)
+            : data_{data}
+            , size_{size} {
+    }
+
+    template <typename Record>
+    [[nodiscard]] Record Read(const FlatSnapshot::Section& section, uint64_t index) const {
+        if (index >= section.count) {
+            throw std::out_of_range("Snapshot record index is out of range");
+        }
+        // Записи старых версий короче - недостающие поля остаются нулевыми
+        Record record{};
+        std::memcpy(&record, data_ + section.offset + index * section.record_size,
+                    std::min<size_t>(section.record_size, sizeof(Record)));
+        return record;
+    }
+
+    [[nodiscard]] std::string_view GetString(FlatSnapshot::StringRef ref) const {
+        if (static_cast<uint64_t>(ref.offset) + ref.size > strings_.count) {
+            throw std::out_of_range("Snapshot string is out of range");
+        }
+        return {data_ + strings_.offset + ref.offset, ref.size};
+    }
+
+    void CheckSection(const FlatSnapshot::Section& section, bool is_string_table = false) const {
+        if (section.record_size == 0 || (is_string_table && section.record_size != 1)) {
+            throw std::runtime_error("Snapshot section has invalid record size");
+        }
+        if (section.offset > size_ || section.count > (size_ - section.offset) / section.record_size) {
+            throw std::runtime_error("Snapshot section is out of file bounds");
+        }
+        if (is_string_table) {
+            strings_ = section;
+        }
+    }
+
+    static void CheckRange(uint64_t first, uint64_t count, const FlatSnapshot::Section& section) {
+        if (first > section.count || count > section.count - first) {
+            throw std::runtime_error("Snapshot record range is out of section bounds");
+        }
+    }
+private:
+    const char* data_;
+    size_t size_;
+    mutable FlatSnapshot::Section strings_;
+};
+
+} // namespace
+
+void FlatSnapshot::Write(const AppRepr& repr, const fs::path& path) {
+    std::vector<SessionRecord> sessions;
+    std::vector<DogRecord> dogs;
+    std::vector<CargoRecord> cargo;
+    std::vector<LootRecord> loots;
+    std::vector<PlayerRecord> players;
+    StringTable strings;
+
+    sessions.reserve(repr.game_.sessions_.size());
+    for (const auto& session : repr.game_.sessions_) {
+        auto& session_record = sessions.emplace_back();
+        session_record.id = session.id_val_;
+        session_record.map_id = strings.Add(session.map_id_val_);
+        session_record.now_ms = session.now_ms_;
+        session_record.first_dog = dogs.size();
+        session_record.dog_count = session.dogs_repr_.size();
+        for (const auto& dog : session.dogs_repr_) {
+            auto& dog_record = dogs.emplace_back();
+            dog_record.id = dog.id_;
+            dog_record.name = strings.Add(dog.name_);
+            dog_record.x = dog.pos_.x;
+            dog_record.y = dog.pos_.y;
+            dog_record.dx = dog.speed_.dx;
+            dog_record.dy = dog.speed_.dy;
+            dog_record.bag_capacity = dog.bag_capacity_;
+            dog_record.direction = static_cast<uint32_t>(dog.direction_);
+            dog_record.score = dog.score_;
+            dog_record.play_time_ms = dog.play_time_ms_;
+            dog_record.nonactive_time_ms = dog.nonactive_time_ms_;
+            dog_record.first_cargo = cargo.size();
+            dog_record.cargo_count = dog.bag_content_.size();
+            for (const auto& item : dog.bag_content_) {
+                cargo.push_back({item.id, item.type, 0});
+            }
+        }
+        session_record.first_loot = loots.size();
+        session_record.loot_count = session.loots_.size();
+        for (const auto& loot : session.loots_) {
+            loots.push_back({loot.id, loot.pos.x, loot.pos.y, loot.type, 0});
+        }
+    }
+
+    players.reserve(repr.players_.players_.size());
+    for (const auto& player : repr.players_.players_) {
+        players.push_back({player.id_val_, player.sess_id_val_, strings.Add(player.name_), strings.Add(player.token_)});
+    }
+
+    Header header;
+    header.magic = MAGIC;
+    header.format_version = FORMAT_VERSION;
+    header.header_size = sizeof(Header);
+    header.journal_segment = repr.journal_segment_;
+    header.next_session_id = repr.next_session_id_;
+
+    uint64_t offset = Align(sizeof(Header));
+    auto place = [&offset](Section& section, uint64_t count, uint32_t record_size) {
+        section = {offset, count, record_size, 0};
+        offset = Align(offset + count * record_size);
+    };
+    place(header.sessions, sessions.size(), sizeof(SessionRecord));
+    place(header.dogs, dogs.size(), sizeof(DogRecord));
+    place(header.cargo, cargo.size(), sizeof(CargoRecord));
+    place(header.loots, loots.size(), sizeof(LootRecord));
+    place(header.players, players.size(), sizeof(PlayerRecord));
+    place(header.strings, strings.GetData().size(), 1);
+    header.file_size = offset;
+
+    // Файл собирается в памяти целиком и пишется одним вызовом
+    std::string buffer(header.file_size, '\0');
+    auto copy = [&buffer](const Section& section, const void* data, size_t bytes) {
+        if (bytes != 0) {
+            std::memcpy(buffer.data() + section.offset, data, bytes);
+        }
+    };
+    copy(header.sessions, sessions.data(), sessions.size() * sizeof(SessionRecord));
+    copy(header.dogs, dogs.data(), dogs.size() * sizeof(DogRecord));
+    copy(header.cargo, cargo.data(), cargo.size() * sizeof(CargoRecord));
+    copy(header.loots, loots.data(), loots.size() * sizeof(LootRecord));
+    copy(header.players, players.data(), players.size() * sizeof(PlayerRecord));
+    copy(header.strings, strings.GetData().data(), strings.GetData().size());
+
+    header.body_checksum = Checksum(buffer.data() + header.header_size, buffer.size() - header.header_size);
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+    header.header_checksum = HeaderChecksum(buffer.data(), header.header_size);
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.flush();
+    if (!file) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+bool FlatSnapshot::Detect(const fs::path& path) {
+    std::ifstream file{path, std::ios::binary};
+    std::array<char, 8> magic{};
+    file.read(magic.data(), magic.size());
+    return file && magic == MAGIC;
+}
+
+FlatSnapshot::Loaded FlatSnapshot::Load(const fs::path& path, const std::shared_ptr<model::Game>& game) {
+    bip::file_mapping mapping{path.c_str(), bip::read_only};
+    bip::mapped_region region{mapping, bip::read_only};
+    const auto* data = static_cast<const char*>(region.get_address());
+    const size_t size = region.get_size();
+
+    Header header;
+    if (size < offsetof(Header, sessions)) {
+        throw std::runtime_error("Snapshot is too short");
+    }
+    std::memcpy(&header, data, std::min(size, sizeof(Header)));
+    if (header.magic != MAGIC) {
+        throw std::runtime_error("Not a flat snapshot");
+    }
+    if (header.format_version == 0 || header.format_version > FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.format_version));
+    }
+    if (header.header_size < MIN_HEADER_SIZE || header.header_size > size || header.file_size != size) {
+        throw std::runtime_error("Snapshot is truncated");
+    }
+    if (header.header_size < sizeof(Header)) {
+        // За коротким заголовком старой версии уже начинаются секции
+        std::memset(reinterpret_cast<char*>(&header) + header.header_size, 0, sizeof(Header) - header.header_size);
+    }
+    if (HeaderChecksum(data, header.header_size) != header.header_checksum
+        || Checksum(data + header.header_size, size - header.header_size) != header.body_checksum) {
+        throw std::runtime_error("Snapshot checksum mismatch");
+    }
+
+    SnapshotReader reader{data, size};
+    reader.CheckSection(header.sessions);
+    reader.CheckSection(header.dogs);
+    reader.CheckSection(header.cargo);
+    reader.CheckSection(header.loots);
+    reader.CheckSection(header.players);
+    reader.CheckSection(header.strings, true);
+
+    // В игру попадает только целиком прочитанный снимок
+    std::vector<std::shared_ptr<model::GameSession>> sessions;
+    sessions.reserve(header.sessions.count);
+    for (uint64_t i = 0; i < header.sessions.count; ++i) {
+        const auto session_record = reader.Read<SessionRecord>(header.sessions, i);
+        SnapshotReader::CheckRange(session_record.first_dog, session_record.dog_count, header.dogs);
+        SnapshotReader::CheckRange(session_record.first_loot, session_record.loot_count, header.loots);
+
+        auto session = std::make_shared<model::GameSession>(
+            session_record.id, game, model::Map::Id{std::string{reader.GetString(session_record.map_id)}});
+        session->SetNow(std::chrono::milliseconds{session_record.now_ms});
+
+        std::map<uint64_t, model::LootItem> loots;
+        for (uint64_t j = 0; j < session_record.loot_count; ++j) {
+            const auto loot = reader.Read<LootRecord>(header.loots, session_record.first_loot + j);
+            loots.emplace_hint(loots.end(), loot.id, model::LootItem{loot.id, loot.type, {loot.x, loot.y}});
+        }
+        session->SetLoots(std::move(loots));
+
+        std::vector<model::Dog> dogs;
+        dogs.reserve(session_record.dog_count);
+        for (uint64_t j = 0; j < session_record.dog_count; ++j) {
+            const auto dog_record = reader.Read<DogRecord>(header.dogs, session_record.first_dog + j);
+            SnapshotReader::CheckRange(dog_record.first_cargo, dog_record.cargo_count, header.cargo);
+            if (dog_record.direction > static_cast<uint32_t>(model::Direction::NONE)) {
+                throw std::runtime_error("Invalid dog direction in snapshot");
+            }
+
+            auto& dog = dogs.emplace_back(dog_record.id, std::string{reader.GetString(dog_record.name)},
+                                          model::Point2D{dog_record.x, dog_record.y}, dog_record.bag_capacity);
+            dog.SetSpeed({dog_record.dx, dog_record.dy});
+            dog.SetDirection(static_cast<model::Direction>(dog_record.direction));
+            dog.AddScore(dog_record.score);
+            dog.AddPlayTime(std::chrono::milliseconds{dog_record.play_time_ms});
+            dog.SetLastActive(session->GetNow() - std::chrono::milliseconds{dog_record.nonactive_time_ms});
+            for (uint64_t k = 0; k < dog_record.cargo_count; ++k) {
+                const auto item = reader.Read<CargoRecord>(header.cargo, dog_record.first_cargo + k);
+                if (!dog.PutToBag({item.id, item.type})) {
+                    throw std::runtime_error("Failed to put bag content");
+                }
+            }
+        }
+        session->SetDogs(std::move(dogs));
+        sessions.push_back(std::move(session));
+    }
+
+    Loaded loaded;
+    loaded.journal_segment = header.journal_segment;
+    loaded.players.Reserve(header.players.count);
+    for (uint64_t i = 0; i < header.players.count; ++i) {
+        const auto player = reader.Read<PlayerRecord>(header.players, i);
+        loaded.players.Add(std::string{reader.GetString(player.name)}, model::GameSession::Id{player.session_id},
+                           player.id, app::Token{reader.GetString(player.token)});
+    }
+
+    for (auto& session : sessions) {
+        game->AddSession(std::move(session));
+    }
+    game->SetNextSessionId(header.next_session_id);
+    return loaded;
+}
+
+} // namespace serialization
@@ -0,0 +1,135 @@
+#ifndef GAME_SERVER_FLAT_SNAPSHOT_H
+#define GAME_SERVER_FLAT_SNAPSHOT_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+
+#include "app.h"
+#include "model.h"
+#include "serialization.h"
+
+namespace serialization {
+
+/*
+ * Плоский снимок состояния для быстрого восстановления.
+ * Файл: заголовок с таблицей секций, затем секции записей фиксированного размера
+ * (сессии, собаки, предметы в рюкзаках, трофеи, игроки) и таблица строк.
+ * Записи ссылаются друг на друга и на строки индексами и смещениями, поэтому
+ * снимок читается из отображённого в память файла без разбора и без копирования строк.
+ * Заголовок и тело защищены CRC32.
+ *
+ * Совместимость: каждая секция хранит размер своей записи. Новые версии формата
+ * только дописывают поля в конец записей и заголовка; читатель берёт известный ему
+ * префикс записи, а незаписанные старым писателем поля получают нулевые значения.
+ */
+class FlatSnapshot {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 3;
+
+    struct Section {
+        uint64_t offset = 0;
+        uint64_t count = 0;
+        uint32_t record_size = 0;
+        uint32_t reserved = 0;
+    };
+
+    struct Header {
+        std::array<char, 8> magic{};
+        uint32_t format_version = 0;
+        uint32_t header_size = 0;
+        uint64_t file_size = 0;
+        uint64_t journal_segment = 0;
+        Section sessions;
+        Section dogs;
+        Section cargo;
+        Section loots;
+        Section players;
+        // Для строк count - размер таблицы в байтах
+        Section strings;
+        uint32_t body_checksum = 0;
+        // Считается при нулевом header_checksum
+        uint32_t header_checksum = 0;
+        // С версии 3: id следующей сессии, без него id удалённых сессий выдались бы снова
+        uint64_t next_session_id = 0;
+    };
+
+    struct StringRef {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    struct SessionRecord {
+        uint64_t id = 0;
+        StringRef map_id;
+        uint64_t first_dog = 0;
+        uint64_t dog_count = 0;
+        uint64_t first_loot = 0;
+        uint64_t loot_count = 0;
+        // С версии 2: время сессии
+        int64_t now_ms = 0;
+    };
+
+    struct DogRecord {
+        uint64_t id = 0;
+        StringRef name;
+        double x = 0.0;
+        double y = 0.0;
+        double dx = 0.0;
+        double dy = 0.0;
+        uint64_t bag_capacity = 0;
+        uint32_t direction = 0;
+        uint32_t score = 0;
+        int64_t play_time_ms = 0;
+        int64_t nonactive_time_ms = 0;
+        uint64_t first_cargo = 0;
+        uint64_t cargo_count = 0;
+    };
+
+    struct CargoRecord {
+        uint64_t id = 0;
+        uint32_t type = 0;
+        uint32_t reserved = 0;
+    };
+
+    struct LootRecord {
+        uint64_t id = 0;
+        double x = 0.0;
+        double y = 0.0;
+        uint32_t type = 0;
+        uint32_t reserved = 0;
+    };
+
+    struct PlayerRecord {
+        uint64_t id = 0;
+        uint64_t session_id = 0;
+        StringRef name;
+        StringRef token;
+    };
+
+    // Результат загрузки: сессии уже добавлены в игру, игроков нужно передать в App
+    struct Loaded {
+        app::Players players;
+        uint64_t journal_segment = 0;
+    };
+
+    static void Write(const AppRepr& repr, const std::filesystem::path& path);
+    // true, если файл начинается с сигнатуры плоского снимка
+    [[nodiscard]] static bool Detect(const std::filesystem::path& path);
+    // Бросает исключение, если снимок повреждён или записан более новой версией
+    [[nodiscard]] static Loaded Load(const std::filesystem::path& path, const std::shared_ptr<model::Game>& game);
+};
+
+// Размеры записей - часть формата: поля без выравнивающих дыр, меняются только с версией
+static_assert(std::is_trivially_copyable_v<FlatSnapshot::Header> && sizeof(FlatSnapshot::Header) == 192);
+static_assert(sizeof(FlatSnapshot::SessionRecord) == 56);
+static_assert(std::is_trivially_copyable_v<FlatSnapshot::DogRecord> && sizeof(FlatSnapshot::DogRecord) == 96);
+static_assert(sizeof(FlatSnapshot::CargoRecord) == 16);
+static_assert(sizeof(FlatSnapshot::LootRecord) == 32);
+static_assert(std::is_trivially_copyable_v<FlatSnapshot::PlayerRecord> && sizeof(FlatSnapshot::PlayerRecord) == 32);
+
+} // namespace serialization
+
+#endif //GAME_SERVER_FLAT_SNAPSHOT_H
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <optional>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "gzip.h"
+
+namespace util {
+
+namespace bio = boost::iostreams;
+
+namespace {
+
+std::string_view Trim(std::string_view str) {
+    const auto first = str.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool EqualsNoCase(std::string_view lhs, std::string_view rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Вес кодировки из параметров вида ";q=0.5"; без q вес равен 1
+double ParseQuality(std::string_view params) {
+    while (!params.empty()) {
+        const auto semicolon = params.find(';');
+        const auto param = Trim(params.substr(0, semicolon));
+        if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+            double quality = 0.0;
+            const auto value = param.substr(2);
+            if (std::from_chars(value.data(), value.data() + value.size(), quality).ec != std::errc{}) {
+                return 0.0;
+            }
+            return quality;
+        }
+        if (semicolon == std::string_view::npos) {
+            break;
+        }
+        params.remove_prefix(semicolon + 1);
+    }
+    return 1.0;
+}
+
+} // namespace
+
+bool AcceptsGzip(std::string_view accept_encoding) {
+    // Явно названный gzip важнее "*"
+    std::optional<double> gzip_quality;
+    std::optional<double> any_quality;
+    while (!accept_encoding.empty()) {
+        const auto comma = accept_encoding.find(',');
+        const auto item = accept_encoding.substr(0, comma);
+        const auto semicolon = item.find(';');
+        const auto coding = Trim(item.substr(0, semicolon));
+        const double quality = semicolon == std::string_view::npos ? 1.0 : ParseQuality(item.substr(semicolon + 1));
+        if (EqualsNoCase(coding, "gzip") || EqualsNoCase(coding, "x-gzip")) {
+            gzip_quality = quality;
+        } else if (coding == "*") {
+            any_quality = quality;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        accept_encoding.remove_prefix(comma + 1);
+    }
+    return gzip_quality.value_or(any_quality.value_or(0.0)) > 0.0;
+}
+
+std::string GzipCompress(std::string_view data, int level) {
+    std::string out;
+    // JSON состояния сжимается примерно в десять раз
+    out.reserve(data.size() / 8 + 64);
+    {
+        bio::filtering_ostream stream;
+        stream.push(bio::gzip_compressor{bio::gzip_params{level}});
+        stream.push(bio::back_inserter(out));
+        stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+    } // поток дописывает хвост gzip при закрытии
+    return out;
+}
+
+GzipCache::GzipCache(int level, size_t slot_count)
+        : level_{level}
+        , slots_(std::max<size_t>(1, slot_count)) {
+}
+
+std::shared_ptr<const std::string> GzipCache::Compress(std::string_view body) {
+    auto& slot = slots_[std::hash<std::string_view>{}(body) % slots_.size()];
+    {
+        std::lock_guard lock{mutex_};
+        if (slot.gzipped && slot.body == body) {
+            return slot.gzipped;
+        }
+    }
+    // Сжатие вне блокировки; при гонке одно и то же тело сожмут дважды, это безвредно
+    auto gzipped = std::make_shared<const std::string>(GzipCompress(body, level_));
+    std::lock_guard lock{mutex_};
+    slot.body = body;
+    slot.gzipped = gzipped;
+    return gzipped;
+}
+
+} // namespace util
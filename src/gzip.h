@@ -0,0 +1,56 @@
+#ifndef GAME_SERVER_GZIP_H
+#define GAME_SERVER_GZIP_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util {
+
+struct GzipOptions {
+    // Тела короче порога не сжимаются: заголовок gzip съест выигрыш
+    size_t min_size = 1024;
+    // Уровень zlib 1-9, 0 выключает сжатие
+    int level = 6;
+
+    [[nodiscard]] bool Enabled() const {
+        return level > 0;
+    }
+    [[nodiscard]] bool ShouldCompress(size_t body_size) const {
+        return Enabled() && body_size >= min_size;
+    }
+};
+
+// Разрешает ли Accept-Encoding ответ в gzip (учитываются q=0 и "*")
+[[nodiscard]] bool AcceptsGzip(std::string_view accept_encoding);
+
+[[nodiscard]] std::string GzipCompress(std::string_view data, int level);
+
+/*
+ * Сжатые тела, адресуемые содержимым: одинаковое тело сжимается один раз,
+ * сколько бы клиентов его ни запросили. Ячейка выбирается по хешу тела,
+ * новое тело вытесняет прежнее из своей ячейки. Потокобезопасен.
+ */
+class GzipCache {
+public:
+    explicit GzipCache(int level, size_t slot_count = 64);
+
+    [[nodiscard]] std::shared_ptr<const std::string> Compress(std::string_view body);
+
+private:
+    struct Slot {
+        std::string body;
+        std::shared_ptr<const std::string> gzipped;
+    };
+
+    int level_;
+    std::mutex mutex_;
+    std::vector<Slot> slots_;
+};
+
+} // namespace util
+
+#endif //GAME_SERVER_GZIP_H
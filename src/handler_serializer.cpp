@@ -11,4 +11,8 @@ void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const Join
     val = {{"authToken", join_msg.auth_token}, {"playerId", join_msg.player_id}};
 }
 
+void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const BatchActionsMsg& actions_msg) {
+    val = {{"applied", actions_msg.applied}, {"rejected", boost::json::value_from(actions_msg.rejected)}};
+}
+
 } // namespace http_handler
\ No newline at end of file
@@ -13,8 +13,14 @@ struct JoinMsg {
     std::string auth_token;
 };
 
+struct BatchActionsMsg {
+    size_t applied = 0;
+    std::vector<size_t> rejected;  // индексы действий с неизвестным токеном
+};
+
 void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const ErrMsg& err_msg);
 void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const JoinMsg& join_msg);
+void tag_invoke(boost::json::value_from_tag, boost::json::value& val, const BatchActionsMsg& actions_msg);
 
 } // namespace http_handler
 
@@ -2,40 +2,158 @@
 #include <filesystem>
 #include <iostream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
 
+#include "flat_snapshot.h"
 #include "infrastructure.h"
 #include "serialization.h"
 #include "logger.h"
 
 namespace infrastructure {
-using InArchive = boost::archive::text_iarchive;
-using OutArchive = boost::archive::text_oarchive;
+// Форматы сохранений до перехода на плоский снимок
+using InArchive = boost::archive::binary_iarchive;
+using TextInArchive = boost::archive::text_iarchive;
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Сбрасывает файл (или каталог) на диск
+void SyncPath(const fs::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+    const int res = ::fsync(fd);
+    ::close(fd);
+    if (res != 0) {
+        throw std::runtime_error("Failed to sync " + path.string());
+    }
+}
+
+template <typename Archive>
+serialization::AppRepr ReadState(const std::string& state_file) {
+    std::ifstream archive_{state_file, std::ios::binary};
+    Archive input_archive{archive_};
+    serialization::AppRepr repr;
+    input_archive >> repr;
+    return repr;
+}
+
+} // namespace
+
+Autosaver::Autosaver(app::App &app, std::string state_file, std::chrono::milliseconds period,
+                     bool use_journal)
+        : app_(app)
+        , state_file_(std::move(state_file))
+        , save_period_(period)
+        , journal_(use_journal && period > std::chrono::milliseconds{0}
+                   ? std::make_unique<Journal>(state_file_) : nullptr)
+        , writer_{[this](const std::stop_token& stop) { Run(stop); }} {
+}
 
 void Autosaver::Restore() {
+    uint64_t journal_segment = 0;
     if (!std::filesystem::exists(state_file_)) {
         logger::Logger::log_json("autosave not found", {{"file", state_file_}});
-        return;
+    } else {
+        try {
+            const auto start = Clock::now();
+            if (serialization::FlatSnapshot::Detect(state_file_)) {
+                auto loaded = serialization::FlatSnapshot::Load(state_file_, app_.GetGame());
+                app_.RestorePlayers(loaded.players);
+                journal_segment = loaded.journal_segment;
+            } else {
+                serialization::AppRepr repr;
+                try {
+                    repr = ReadState<InArchive>(state_file_);
+                } catch (const boost::archive::archive_exception&) {
+                    repr = ReadState<TextInArchive>(state_file_);
+                }
+                repr.Restore(app_);
+                journal_segment = repr.GetJournalSegment();
+            }
+            logger::Logger::log_json("autosave restored", {{"file", state_file_}, {"ms", ElapsedMs(start)}});
+        }
+        catch (const std::exception& ex) {
+            // Без контрольной точки журнал применять не к чему, а первый же автосейв
+            // затёр бы файл и удалил журнал - останавливаемся, не трогая их
+            logger::Logger::log_json("restore error", {{"error", ex.what()}});
+            throw;
+        }
     }
-    try {
-        std::ifstream archive_{state_file_};
-        InArchive input_archive{archive_ };
-        serialization::AppRepr repr;
-        input_archive >> repr;
-        repr.Restore(app_);
-        logger::Logger::log_json("autosave restored", {{"file", state_file_}});
+
+    if (journal_) {
+        try {
+            journal_->Replay(app_, journal_segment);
+        }
+        catch (const std::exception& ex) {
+            logger::Logger::log_json("journal replay error", {{"error", ex.what()}});
+            throw;
+        }
+        journal_->Start(app_);
     }
-    catch (const std::exception& ex) {
-        logger::Logger::log_json("restore error", {{"error", ex.what()}});
+}
+
+Autosaver::Snapshot Autosaver::Capture() {
+    const auto start = Clock::now();
+    Snapshot snapshot;
+    // Изменения после снимка пишутся в новый сегмент журнала
+    snapshot.journal_segment = journal_ ? journal_->Rotate() : 0;
+    const auto& sessions = app_.GetGame()->GetSessions();
+    snapshot.sessions.reserve(sessions.size());
+    for (const auto& [id, session] : sessions) {
+        snapshot.sessions.push_back(session->GetSnapshot());
+    }
+    snapshot.next_session_id = app_.GetGame()->GetNextSessionId();
+    snapshot.players = app_.GetPlayersSnapshot();
+    {
+        std::lock_guard lock{mutex_};
+        snapshot.generation = next_generation_++;
+    }
+    capture_ms_.Observe(ElapsedMs(start));
+    return snapshot;
+}
+
+void Autosaver::Write(Snapshot snapshot) {
+    std::lock_guard lock{write_mutex_};
+    if (snapshot.generation <= written_generation_) {
+        return;
+    }
+    const auto start = Clock::now();
+    const serialization::AppRepr repr{snapshot.sessions, *snapshot.players, snapshot.journal_segment,
+                                      snapshot.next_session_id};
+    // Пока снимок жив, симуляция копирует изменяемые собак, трофеи и игроков - отпускаем его до записи на диск
+    snapshot.sessions.clear();
+    snapshot.players.reset();
+
+    const fs::path state_path{state_file_};
+    const fs::path tmp_path{state_file_ + ".tmp"};
+    serialization::FlatSnapshot::Write(repr, tmp_path);
+    SyncPath(tmp_path);
+    // После rename в state_file всегда лежит целое сохранение - старое или новое
+    fs::rename(tmp_path, state_path);
+    SyncPath(state_path.has_parent_path() ? state_path.parent_path() : fs::path{"."});
+    written_generation_ = snapshot.generation;
+    if (journal_) {
+        // Сегменты до снимка больше не нужны для восстановления
+        journal_->DropBefore(snapshot.journal_segment);
     }
+    write_ms_.Observe(ElapsedMs(start));
 }
 
 void Autosaver::Save() {
     try {
-        std::ofstream archive_{state_file_};
-        OutArchive output_archive{archive_};
-        output_archive << serialization::AppRepr{app_};
+        Write(Capture());
         logger::Logger::log_json("state saved", {{"file", state_file_}});
     }
     catch (const std::exception& ex) {
@@ -49,12 +167,45 @@ void Autosaver::Save() {
 }
 
 void Autosaver::OnTick(std::chrono::milliseconds delta) {
+    if (journal_) {
+        journal_->Append(app_);
+    }
     elapsed_ += delta;
     if (save_period_ > std::chrono::milliseconds{0}
         && elapsed_ >= save_period_) {
-        Save();
+        auto snapshot = Capture();
+        {
+            std::lock_guard lock{mutex_};
+            if (pending_) {
+                skipped_.Add();
+            }
+            pending_ = std::move(snapshot);
+        }
+        cond_var_.notify_one();
         elapsed_ = std::chrono::milliseconds{0};
     }
 }
 
+void Autosaver::Run(const std::stop_token& stop) {
+    while (true) {
+        Snapshot snapshot;
+        {
+            std::unique_lock lock{mutex_};
+            cond_var_.wait(lock, stop, [this] { return pending_.has_value(); });
+            if (!pending_) {
+                return; // остановка
+            }
+            snapshot = std::move(*pending_);
+            pending_.reset();
+        }
+
+        try {
+            Write(std::move(snapshot));
+            logger::Logger::log_json("state saved", {{"file", state_file_}});
+        } catch (const std::exception& ex) {
+            logger::Logger::log_json("autosave error", {{"error", ex.what()}});
+        }
+    }
+}
+
 } // namespace infrastructure
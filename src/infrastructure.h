@@ -2,30 +2,82 @@
 #define INFRASTRUCTURE_H
 
 #include <chrono>
+#include <cstdint>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include "app.h"
+#include "journal.h"
+#include "metrics.h"
 
 namespace infrastructure {
 
+/*
+ * Автосохранение состояния.
+ * На тике только берутся неизменяемые снимки сессий и игроков (без копирования,
+ * см. GameSession::GetSnapshot), представление для записи строит и пишет фоновый поток:
+ * плоский снимок во временный файл, fsync, атомарный rename.
+ * Если запись не успевает, промежуточные снимки пропускаются - пишется последний.
+ * С журналом изменения каждого тика дописываются в Journal, а снимок служит
+ * контрольной точкой: при восстановлении журнал применяется поверх него.
+ */
 class Autosaver {
 public:
-    explicit Autosaver(app::App &app, std::string state_file, std::chrono::milliseconds period)
-            : app_(app)
-            , state_file_(std::move(state_file))
-            , save_period_(period) {
-    }
+    explicit Autosaver(app::App &app, std::string state_file, std::chrono::milliseconds period,
+                       bool use_journal = false);
+    Autosaver(const Autosaver&) = delete;
+    Autosaver& operator=(const Autosaver&) = delete;
+
+    // Снимает и записывает состояние в вызывающем потоке
     void Save();
     void OnTick(std::chrono::milliseconds delta);
+    // Читает бинарный архив, а сохранения старых версий - как текстовый.
+    // Вызывается до начала тиков: с журналом он применяется поверх снимка.
+    // Если снимок или журнал есть, но не читается, бросает исключение и файлы не трогает
     void Restore();
+private:
+    struct Snapshot {
+        std::vector<model::GameSession::Snapshot> sessions;
+        std::shared_ptr<const app::Players::PlayerMap> players;
+        uint64_t journal_segment = 0;
+        model::GameSession::Id::ValueType next_session_id = 0;
+        // Более старый снимок не перезапишет более новый
+        uint64_t generation = 0;
+    };
+
+    // Вызывается в потоке симуляции
+    [[nodiscard]] Snapshot Capture();
+    void Write(Snapshot snapshot);
+    void Run(const std::stop_token& stop);
 private:
     app::App &app_;
     std::string state_file_;
     std::chrono::milliseconds save_period_;
     std::chrono::milliseconds elapsed_ = std::chrono::milliseconds(0);
+    std::unique_ptr<Journal> journal_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cond_var_;
+    std::optional<Snapshot> pending_;
+    uint64_t next_generation_ = 1;
+    // Save и фоновый поток пишут через один и тот же временный файл
+    std::mutex write_mutex_;
+    uint64_t written_generation_ = 0;
+
+    metrics::Histogram& capture_ms_ = metrics::Registry::get_instance().GetHistogram("autosave.capture_ms");
+    metrics::Histogram& write_ms_ = metrics::Registry::get_instance().GetHistogram("autosave.write_ms");
+    metrics::Counter& skipped_ = metrics::Registry::get_instance().GetCounter("autosave.skipped");
+
+    // Останавливается первым и дописывает последний снимок
+    std::jthread writer_;
 };
 
 } // namespace infrastructure
 
-#endif  // INFRASTRUCTURE_H
\ No newline at end of file
+#endif  // INFRASTRUCTURE_H
@@ -0,0 +1,266 @@
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/crc.hpp>
+
+#include "journal.h"
+#include "logger.h"
+#include "serialization.h"
+
+namespace infrastructure {
+
+namespace fs = std::filesystem;
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr std::string_view SEGMENT_SUFFIX = ".journal.";
+constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+uint32_t Checksum(std::string_view data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+void AppendFrame(std::string& out, const serialization::TickDeltaRepr& delta) {
+    std::ostringstream strm;
+    {
+        boost::archive::binary_oarchive output_archive{strm, boost::archive::no_header};
+        output_archive << delta;
+    }
+    const std::string payload = strm.str();
+    const auto size = static_cast<uint32_t>(payload.size());
+    const auto checksum = Checksum(payload);
+    out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    out += payload;
+}
+
+void WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const auto written = ::write(fd, data.data(), data.size());
+        if (written < 0) {
+            throw std::runtime_error("Journal write failed: "s + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
+} // namespace
+
+Journal::Journal(std::string state_file)
+        : state_file_{std::move(state_file)}
+        , writer_{[this](const std::stop_token& stop) { Run(stop); }} {
+}
+
+Journal::~Journal() {
+    Stop();
+}
+
+fs::path Journal::GetSegmentPath(uint64_t segment) const {
+    return state_file_ + std::string{SEGMENT_SUFFIX} + std::to_string(segment);
+}
+
+std::vector<uint64_t> Journal::ListSegments() const {
+    const fs::path state_path{state_file_};
+    const fs::path dir = state_path.has_parent_path() ? state_path.parent_path() : fs::path{"."};
+    const std::string prefix = state_path.filename().string() + std::string{SEGMENT_SUFFIX};
+
+    std::vector<uint64_t> segments;
+    if (!fs::exists(dir)) {
+        return segments;
+    }
+    for (const auto& entry : fs::directory_iterator{dir}) {
+        const auto name = entry.path().filename().string();
+        if (!name.starts_with(prefix)) {
+            continue;
+        }
+        uint64_t segment = 0;
+        const char* first = name.data() + prefix.size();
+        const char* last = name.data() + name.size();
+        if (auto [ptr, ec] = std::from_chars(first, last, segment); ec == std::errc{} && ptr == last) {
+            segments.push_back(segment);
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void Journal::Replay(app::App& app, uint64_t first_segment) {
+    size_t applied = 0;
+    for (auto segment : ListSegments()) {
+        if (segment < first_segment) {
+            continue;
+        }
+
+        std::ifstream file{GetSegmentPath(segment), std::ios::binary};
+        const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        size_t pos = 0;
+        while (pos + FRAME_HEADER_SIZE <= data.size()) {
+            uint32_t size = 0;
+            uint32_t checksum = 0;
+            std::memcpy(&size, data.data() + pos, sizeof(size));
+            std::memcpy(&checksum, data.data() + pos + sizeof(size), sizeof(checksum));
+            if (pos + FRAME_HEADER_SIZE + size > data.size()) {
+                break;
+            }
+            const std::string_view payload{data.data() + pos + FRAME_HEADER_SIZE, size};
+            if (Checksum(payload) != checksum) {
+                break;
+            }
+
+            std::istringstream strm{std::string{payload}};
+            boost::archive::binary_iarchive input_archive{strm, boost::archive::no_header};
+            serialization::TickDeltaRepr delta;
+            input_archive >> delta;
+            delta.Apply(app);
+            ++applied;
+            pos += FRAME_HEADER_SIZE + size;
+        }
+
+        if (pos != data.size()) {
+            // Хвост, не дописанный до падения: всё, что за ним, применять нельзя
+            logger::Logger::log_json("journal truncated", {{"segment", segment}, {"offset", pos}});
+            break;
+        }
+    }
+    logger::Logger::log_json("journal replayed", {{"records", applied}});
+}
+
+void Journal::Start(app::App& app) {
+    for (const auto& [id, session] : app.GetGame()->GetSessions()) {
+        session->CloseVersion();
+        session_versions_[id] = session->GetVersion();
+    }
+    app.TrackPlayerChanges();
+    [[maybe_unused]] auto restored = app.TakePlayerChanges();
+
+    // Недописанный сегмент не продолжаем - пишем в новый
+    const auto segments = ListSegments();
+    segment_ = segments.empty() ? 0 : segments.back() + 1;
+}
+
+void Journal::Append(app::App& app) {
+    const auto& game_sessions = app.GetGame()->GetSessions();
+    // Удалённые сессии не вернутся - их id больше не выдаются
+    std::erase_if(session_versions_, [&game_sessions](const auto& entry) {
+        return !game_sessions.contains(entry.first);
+    });
+
+    std::vector<serialization::SessionDeltaRepr> sessions;
+    for (const auto& [id, session] : game_sessions) {
+        auto [it, inserted] = session_versions_.try_emplace(id, 0);
+        auto changes = session->GetChangesSince(it->second);
+        if (!changes) {
+            throw std::logic_error("Journal fell behind session " + std::to_string(id));
+        }
+        it->second = session->GetVersion();
+        if (!changes->IsEmpty()) {
+            sessions.emplace_back(*session, *changes);
+        }
+    }
+
+    auto delta = std::make_shared<const serialization::TickDeltaRepr>(std::move(sessions), app.TakePlayerChanges());
+    if (delta->IsEmpty()) {
+        return;
+    }
+    {
+        std::lock_guard lock{mutex_};
+        queue_.emplace_back(segment_, std::move(delta));
+    }
+    cond_var_.notify_one();
+}
+
+uint64_t Journal::Rotate() {
+    return ++segment_;
+}
+
+void Journal::DropBefore(uint64_t segment) {
+    for (auto old_segment : ListSegments()) {
+        if (old_segment >= segment) {
+            break;
+        }
+        std::error_code ec;
+        fs::remove(GetSegmentPath(old_segment), ec);
+    }
+}
+
+void Journal::Stop() {
+    if (writer_.joinable()) {
+        writer_.request_stop();
+        writer_.join();
+    }
+}
+
+void Journal::Run(const std::stop_token& stop) {
+    while (true) {
+        std::vector<std::pair<uint64_t, Delta>> entries;
+        {
+            std::unique_lock lock{mutex_};
+            cond_var_.wait(lock, stop, [this] { return !queue_.empty(); });
+            if (queue_.empty()) {
+                break; // остановка и писать больше нечего
+            }
+            entries.swap(queue_);
+        }
+
+        try {
+            Commit(entries);
+        } catch (const std::exception& ex) {
+            logger::Logger::log_json("journal error", {{"error", ex.what()}, {"count", entries.size()}});
+        }
+    }
+
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void Journal::Commit(const std::vector<std::pair<uint64_t, Delta>>& entries) {
+    const auto start = Clock::now();
+    std::string buffer;
+    auto flush = [this, &buffer] {
+        if (fd_ >= 0 && !buffer.empty()) {
+            WriteAll(fd_, buffer);
+            bytes_.Add(buffer.size());
+            buffer.clear();
+        }
+    };
+
+    for (const auto& [segment, delta] : entries) {
+        if (fd_ < 0 || segment != open_segment_) {
+            flush();
+            if (fd_ >= 0) {
+                ::fdatasync(fd_);
+                ::close(fd_);
+            }
+            fd_ = ::open(GetSegmentPath(segment).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd_ < 0) {
+                throw std::runtime_error("Failed to open journal segment: "s + std::strerror(errno));
+            }
+            open_segment_ = segment;
+        }
+        AppendFrame(buffer, *delta);
+    }
+    flush();
+    // Групповая фиксация: один fdatasync на все записи пачки
+    if (fd_ >= 0 && ::fdatasync(fd_) != 0) {
+        throw std::runtime_error("Journal sync failed: "s + std::strerror(errno));
+    }
+    records_.Add(entries.size());
+    commit_ms_.Observe(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+} // namespace infrastructure
@@ -0,0 +1,83 @@
+#ifndef GAME_SERVER_JOURNAL_H
+#define GAME_SERVER_JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "app.h"
+#include "metrics.h"
+
+namespace serialization {
+class TickDeltaRepr;
+} // namespace serialization
+
+namespace infrastructure {
+
+/*
+ * Журнал изменений между снимками состояния.
+ * На каждом тике Append снимает изменения сессий и игроков (serialization::TickDeltaRepr),
+ * фоновый поток дописывает накопившиеся записи и делает один fdatasync на всю пачку.
+ * Журнал разбит на сегменты <state-file>.journal.<N>: перед снимком Rotate начинает
+ * новый сегмент, после записи снимка более старые сегменты удаляет DropBefore.
+ * Кадр записи: [размер][crc32][бинарный архив TickDeltaRepr без заголовка].
+ */
+class Journal {
+public:
+    explicit Journal(std::string state_file);
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal();
+
+    // Применяет сегменты начиная с first_segment до первого повреждённого кадра
+    void Replay(app::App& app, uint64_t first_segment);
+    // Текущее состояние считается записанным, дальше пишутся только изменения
+    void Start(app::App& app);
+    // Вызывается в потоке симуляции после тика
+    void Append(app::App& app);
+    // Вызывается в потоке симуляции, возвращает номер нового сегмента
+    [[nodiscard]] uint64_t Rotate();
+    void DropBefore(uint64_t segment);
+    // Дописывает очередь и останавливает фоновый поток
+    void Stop();
+private:
+    using Delta = std::shared_ptr<const serialization::TickDeltaRepr>;
+
+    [[nodiscard]] std::filesystem::path GetSegmentPath(uint64_t segment) const;
+    // Номера существующих сегментов по возрастанию
+    [[nodiscard]] std::vector<uint64_t> ListSegments() const;
+    void Run(const std::stop_token& stop);
+    void Commit(const std::vector<std::pair<uint64_t, Delta>>& entries);
+private:
+    std::string state_file_;
+
+    // Используются только в потоке симуляции
+    std::map<uint64_t, uint64_t> session_versions_;
+    uint64_t segment_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable_any cond_var_;
+    std::vector<std::pair<uint64_t, Delta>> queue_;
+
+    // Используются только фоновым потоком
+    int fd_ = -1;
+    uint64_t open_segment_ = 0;
+
+    metrics::Histogram& commit_ms_ = metrics::Registry::get_instance().GetHistogram("journal.commit_ms");
+    metrics::Counter& records_ = metrics::Registry::get_instance().GetCounter("journal.records");
+    metrics::Counter& bytes_ = metrics::Registry::get_instance().GetCounter("journal.bytes");
+
+    std::jthread writer_;
+};
+
+} // namespace infrastructure
+
+#endif //GAME_SERVER_JOURNAL_H
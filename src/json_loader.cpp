@@ -1,58 +1,105 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <boost/json.hpp>
 
+#include "config_cache.h"
 #include "json_loader.h"
+#include "logger.h"
 #include "model_json.h"
 
 namespace json = boost::json;
 
 namespace json_loader {
 
-constexpr int MS_PER_SEC = 1000;
-
-std::shared_ptr<model::Game> LoadGame(const std::filesystem::path& json_path) {
+namespace {
 
-    // TODO: spaghetti code, refactor
+constexpr int MS_PER_SEC = 1000;
+constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
 
-    std::ifstream json_file(json_path);
+// Файл скармливается парсеру кусками, целиком в памяти он не держится
+json::value ParseFile(const std::filesystem::path& json_path) {
+    std::ifstream json_file(json_path, std::ios::binary);
     if (!json_file.is_open()) {
         throw std::runtime_error("Failed to open json file: " + json_path.string());
     }
-    std::string json_string((std::istreambuf_iterator<char>(json_file)), std::istreambuf_iterator<char>());
+    // Дерево живёт только до конца загрузки, поэтому память под него не освобождается по частям
+    json::stream_parser parser{json::make_shared_resource<json::monotonic_resource>()};
+    std::vector<char> chunk(READ_CHUNK_SIZE);
+    while (json_file) {
+        json_file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        parser.write(chunk.data(), static_cast<size_t>(json_file.gcount()));
+    }
+    parser.finish();
+    return parser.release();
+}
 
-    const auto game_json = json::parse(json_string);
+struct ParsedGame {
+    std::shared_ptr<model::Game> game;
+    GameSettings settings;
+};
 
-    auto game = std::make_shared<model::Game>();
-    game->SetDefaultSpeed(json::value_to<double>(game_json.at("defaultDogSpeed")));
+ParsedGame ParseGame(const std::filesystem::path& json_path) {
+    const auto game_json = ParseFile(json_path);
+
+    GameSettings settings;
+    settings.default_speed = json::value_to<double>(game_json.at("defaultDogSpeed"));
     if (game_json.as_object().contains("defaultBagCapacity")) {
-        game->SetDefaultBagSize(json::value_to<size_t>(game_json.at("defaultBagCapacity")));
+        settings.default_bag_size = json::value_to<size_t>(game_json.at("defaultBagCapacity"));
     }
-
     auto loot_sec_interval = json::value_to<double>(game_json.at("lootGeneratorConfig").at("period"));
-    std::chrono::milliseconds loot_interval(static_cast<int>(loot_sec_interval * MS_PER_SEC));
-    auto loot_chance = json::value_to<double>(game_json.at("lootGeneratorConfig").at("probability"));
-    auto loot_gen_ptr = std::make_shared<loot::LootGenerator>(loot_interval, loot_chance);
-    game->SetLootGenerator(loot_gen_ptr);
+    settings.loot_period_ms = static_cast<int>(loot_sec_interval * MS_PER_SEC);
+    settings.loot_probability = json::value_to<double>(game_json.at("lootGeneratorConfig").at("probability"));
+    settings.retirement_time = json::value_to<double>(game_json.at("dogRetirementTime"));
 
-    auto retirement_time = json::value_to<double>(game_json.at("dogRetirementTime"));
-    game->SetRetirementTime(retirement_time);
+    auto game = std::make_shared<model::Game>();
+    settings.ApplyTo(*game);
+
+    // Карты переносятся в таблицу по одной, без общего вектора настроек
+    auto table = std::make_shared<model::MapTable>();
+    for (const auto& map_json : game_json.at("maps").as_array()) {
+        auto [map, map_loots, speed, bag_size, view_radius] = json::value_to<model::MapSettings>(map_json);
+        map.SetSpeed(speed ? speed.value() : game->GetDefaultSpeed());
+        map.SetBagSize(bag_size ? bag_size.value() : game->GetDefaultBagSize());
+        map.SetViewRadius(view_radius);
+        auto map_id = map.GetId();
+        table->Add(std::move(map));
+        table->loot_data.emplace(std::move(map_id), std::move(map_loots));
+    }
+    game->SetMapTable(std::move(table));
+
+    return {std::move(game), settings};
+}
+
+} // namespace
 
-    auto map_data = json::value_to<std::vector<model::MapSettings>>(game_json.at("maps"));
+std::shared_ptr<model::Game> LoadGame(const std::filesystem::path& json_path,
+                                      const std::filesystem::path& cache_path) {
+    if (cache_path.empty()) {
+        return ParseGame(json_path).game;
+    }
 
-    std::map<model::Map::Id, loot::MapLootTypes> loot;
-    for (auto& [map, map_loots, speed, bag_size] : map_data) {
-        double map_speed = speed ? speed.value() : game->GetDefaultSpeed();
-        map.SetSpeed(map_speed);
-        size_t map_bag_size = bag_size ? bag_size.value() : game->GetDefaultBagSize();
-        map.SetBagSize(map_bag_size);
-        game->AddMap(map);
-        loot.insert({map.GetId(), map_loots});
+    if (!std::filesystem::exists(json_path)) {
+        throw std::runtime_error("Failed to open json file: " + json_path.string());
+    }
+    const auto key = ConfigCache::MakeKey(json_path);
+    try {
+        if (auto game = ConfigCache::Load(cache_path, key)) {
+            return game;
+        }
+    } catch (const std::exception& ex) {
+        logger::Logger::log_json("config cache ignored", {{"file", cache_path.string()}, {"error", ex.what()}});
     }
-    game->SetLootData(loot);
 
+    auto [game, settings] = ParseGame(json_path);
+    // Без кэша сервер работает, только следующий старт будет медленным
+    try {
+        ConfigCache::Write(cache_path, key, settings, *game);
+    } catch (const std::exception& ex) {
+        logger::Logger::log_json("config cache write failed", {{"file", cache_path.string()}, {"error", ex.what()}});
+    }
     return game;
 }
 
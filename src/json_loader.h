@@ -8,8 +8,13 @@
 
 namespace json_loader {
 
-std::shared_ptr<model::Game> LoadGame(const std::filesystem::path& json_path);
+/*
+ * Если задан cache_path, игра берётся из скомпилированного кэша того же конфига,
+ * а при промахе конфиг разбирается и кэш перезаписывается.
+ */
+std::shared_ptr<model::Game> LoadGame(const std::filesystem::path& json_path,
+                                      const std::filesystem::path& cache_path = {});
 
 }  // namespace json_loader
 
-#endif  // JSON_LOADER_H
\ No newline at end of file
+#endif  // JSON_LOADER_H
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <iterator>
+
+#include "leaderboard.h"
+
+namespace leaderboard {
+
+/*
+ * TopRecords methods
+ */
+void TopRecords::Warm(const domain::Retirees& records, size_t capacity) {
+    std::lock_guard lock{mutex_};
+    capacity_ = capacity;
+    records_.insert(records.begin(), records.end());
+    while (records_.size() > capacity_) {
+        records_.erase(std::prev(records_.end()));
+    }
+    complete_ = records.size() < capacity_;
+    warmed_ = true;
+}
+
+void TopRecords::Add(const domain::Retirees& records) {
+    std::lock_guard lock{mutex_};
+    if (!warmed_) {
+        return;
+    }
+    for (const auto& record : records) {
+        records_.insert(record);
+    }
+    while (records_.size() > capacity_) {
+        // Вытесненная запись осталась только в БД
+        records_.erase(std::prev(records_.end()));
+        complete_ = false;
+    }
+}
+
+size_t TopRecords::FindPosition(const domain::RecordsCursor& after) const {
+    auto it = records_.lower_bound({after.name, after.score, after.game_duration});
+    for (unsigned skipped = 0; skipped < after.skip && it != records_.end() && domain::IsSameRank(*it, after); ++skipped) {
+        ++it;
+    }
+    return static_cast<size_t>(std::distance(records_.begin(), it));
+}
+
+std::optional<domain::Retirees> TopRecords::GetPage(const domain::RecordsQuery& query) const {
+    const auto& max_items = query.max_items;
+
+    std::lock_guard lock{mutex_};
+    if (!warmed_) {
+        return std::nullopt;
+    }
+    const size_t first = query.after ? FindPosition(*query.after)
+                                     : static_cast<size_t>(std::max(query.start.value_or(0), 0));
+    if (!complete_ && (!max_items || first + static_cast<size_t>(std::max(*max_items, 0)) > records_.size())) {
+        return std::nullopt;
+    }
+
+    domain::Retirees page;
+    if (first >= records_.size()) {
+        return page;
+    }
+    auto it = std::next(records_.begin(), static_cast<std::ptrdiff_t>(first));
+    const size_t count = std::min(max_items ? static_cast<size_t>(std::max(*max_items, 0)) : records_.size(),
+                                  records_.size() - first);
+    page.reserve(count);
+    for (size_t i = 0; i < count; ++i, ++it) {
+        page.push_back(*it);
+    }
+    return page;
+}
+
+} // namespace leaderboard
@@ -0,0 +1,80 @@
+#ifndef GAME_SERVER_LEADERBOARD_H
+#define GAME_SERVER_LEADERBOARD_H
+
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "domain.h"
+
+namespace leaderboard {
+
+/*
+ * Верхние capacity рекордов в памяти.
+ * Заполняется из БД на старте и дописывается при каждом выходе собак на пенсию.
+ * Страницы за пределами кэша нужно запрашивать у БД.
+ */
+class TopRecords {
+public:
+    // records - первые записи таблицы в порядке domain::RecordOrder, не больше capacity
+    void Warm(const domain::Retirees& records, size_t capacity);
+    void Add(const domain::Retirees& records);
+    // nullopt, если кэш не может ответить на запрос полностью
+    [[nodiscard]] std::optional<domain::Retirees> GetPage(const domain::RecordsQuery& query) const;
+private:
+    // Номер первой записи после курсора, вызывается под захваченным mutex_
+    [[nodiscard]] size_t FindPosition(const domain::RecordsCursor& after) const;
+private:
+    mutable std::mutex mutex_;
+    std::multiset<domain::RetiredDog, domain::RecordOrder> records_;
+    size_t capacity_ = 0;
+    bool warmed_ = false;
+    // В кэше лежат все записи, что есть в БД
+    bool complete_ = false;
+};
+
+/*
+ * Объединение одновременных одинаковых запросов в один.
+ * Первый вызвавший Join по ключу выполняет запрос и вызывает Complete,
+ * остальные только ждут его результата.
+ */
+template <typename Key, typename Result>
+class SingleFlight {
+public:
+    using Callback = std::move_only_function<void(std::exception_ptr, Result)>;
+
+    // true, если вызывающий должен сам выполнить запрос
+    bool Join(const Key& key, Callback callback) {
+        std::lock_guard lock{mutex_};
+        auto [it, inserted] = in_flight_.try_emplace(key);
+        it->second.push_back(std::move(callback));
+        return inserted;
+    }
+
+    void Complete(const Key& key, std::exception_ptr error, const Result& result) {
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard lock{mutex_};
+            auto node = in_flight_.extract(key);
+            if (node.empty()) {
+                return;
+            }
+            callbacks = std::move(node.mapped());
+        }
+        for (auto& callback : callbacks) {
+            callback(error, result);
+        }
+    }
+private:
+    std::mutex mutex_;
+    std::map<Key, std::vector<Callback>> in_flight_;
+};
+
+} // namespace leaderboard
+
+#endif //GAME_SERVER_LEADERBOARD_H
@@ -0,0 +1,125 @@
+#include <algorithm>
+
+#include "metrics.h"
+
+namespace metrics {
+
+/*
+ * Counter methods
+ */
+void Counter::Add(uint64_t value) noexcept {
+    value_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Counter::Get() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+}
+
+/*
+ * Gauge methods
+ */
+void Gauge::Set(double value) noexcept {
+    value_.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::Add(double value) noexcept {
+    value_.fetch_add(value, std::memory_order_relaxed);
+}
+
+double Gauge::Get() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+}
+
+/*
+ * Histogram methods
+ */
+Histogram::Histogram(std::vector<double> bounds)
+        : bounds_(std::move(bounds))
+        , buckets_(std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1)) {
+    std::sort(bounds_.begin(), bounds_.end());
+}
+
+void Histogram::Observe(double value) noexcept {
+    const auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    auto max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+json::value Histogram::ToJson() const {
+    json::array buckets;
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        json::object bucket;
+        bucket["le"] = i < bounds_.size() ? json::value(bounds_[i]) : json::value("inf");
+        bucket["count"] = buckets_[i].load(std::memory_order_relaxed);
+        buckets.push_back(std::move(bucket));
+    }
+    json::object result;
+    result["count"] = count_.load(std::memory_order_relaxed);
+    result["sum"] = sum_.load(std::memory_order_relaxed);
+    result["max"] = max_.load(std::memory_order_relaxed);
+    result["buckets"] = std::move(buckets);
+    return result;
+}
+
+const std::vector<double>& DefaultMsBounds() {
+    static const std::vector<double> bounds{0.1, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 5000};
+    return bounds;
+}
+
+/*
+ * Registry methods
+ */
+Counter& Registry::GetCounter(const std::string& name) {
+    std::lock_guard lock{mutex_};
+    auto& counter = counters_[name];
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge& Registry::GetGauge(const std::string& name) {
+    std::lock_guard lock{mutex_};
+    auto& gauge = gauges_[name];
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+Histogram& Registry::GetHistogram(const std::string& name, const std::vector<double>& bounds) {
+    std::lock_guard lock{mutex_};
+    auto& histogram = histograms_[name];
+    if (!histogram) {
+        histogram = std::make_unique<Histogram>(bounds);
+    }
+    return *histogram;
+}
+
+json::value Registry::ToJson() const {
+    std::lock_guard lock{mutex_};
+    json::object counters;
+    for (const auto& [name, counter] : counters_) {
+        counters[name] = counter->Get();
+    }
+    json::object gauges;
+    for (const auto& [name, gauge] : gauges_) {
+        gauges[name] = gauge->Get();
+    }
+    json::object histograms;
+    for (const auto& [name, histogram] : histograms_) {
+        histograms[name] = histogram->ToJson();
+    }
+    json::object result;
+    result["counters"] = std::move(counters);
+    result["gauges"] = std::move(gauges);
+    result["histograms"] = std::move(histograms);
+    return result;
+}
+
+} // namespace metrics
@@ -0,0 +1,80 @@
+#ifndef GAME_SERVER_METRICS_H
+#define GAME_SERVER_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/json.hpp>
+
+namespace metrics {
+
+namespace json = boost::json;
+
+class Counter {
+public:
+    void Add(uint64_t value = 1) noexcept;
+    [[nodiscard]] uint64_t Get() const noexcept;
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void Set(double value) noexcept;
+    void Add(double value) noexcept;
+    [[nodiscard]] double Get() const noexcept;
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/*
+ * Гистограмма с фиксированными верхними границами корзин.
+ * Последняя корзина - всё, что больше последней границы.
+ */
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+    void Observe(double value) noexcept;
+    [[nodiscard]] json::value ToJson() const;
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.0};
+    std::atomic<double> max_{0.0};
+};
+
+// Границы по умолчанию для длительностей в миллисекундах
+const std::vector<double>& DefaultMsBounds();
+
+/*
+ * Реестр метрик процесса. Ссылки на метрики стабильны - их можно получить один раз и сохранить.
+ */
+class Registry {
+public:
+    static Registry& get_instance() {
+        static Registry instance;
+        return instance;
+    }
+
+    Counter& GetCounter(const std::string& name);
+    Gauge& GetGauge(const std::string& name);
+    Histogram& GetHistogram(const std::string& name, const std::vector<double>& bounds = DefaultMsBounds());
+    [[nodiscard]] json::value ToJson() const;
+private:
+    Registry() = default;
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<Histogram>> histograms_;
+};
+
+} // namespace metrics
+
+#endif //GAME_SERVER_METRICS_H
@@ -1,8 +1,10 @@
+#include <iterator>
 #include <random>
 #include <stdexcept>
 #include <utility>
 
 #include "collision_detector.h"
+#include "copy_on_write.h"
 #include "model.h"
 #include "model_dog.h"
 #include "model_geometry.h"
@@ -22,61 +24,144 @@ constexpr int MSEC_IN_SEC = 1000;
 GameSession::GameSession(Id::ValueType id, std::shared_ptr<Game> game, Map::Id map_id)
     : id_(id)
     , game_{std::move(game)}
-    , map_id_{std::move(map_id)} {
+    , map_id_{std::move(map_id)}
+    , map_{game_->FindMap(map_id_)}
+    , rng_{game_->GetSeed(), id} {
+    if (!map_) {
+        throw std::invalid_argument("Map with id "s + *map_id_ + " not found"s);
+    }
     loot_data_ = game_->GetLootData(map_id_);
+    // Генератор игры - образец настроек, состояние у сессии своё
+    if (auto loot_generator = game_->GetLootGenerator()) {
+        loot_generator_.emplace(*loot_generator);
+    }
 }
 
 void GameSession::AddDog(Dog::Id::ValueType id, const std::string &name) {
-    Dog dog{id, name, GeneratePosition(), game_->FindMap(map_id_)->GetBagSize()};
+    Dog dog{id, name, GeneratePosition(), map_->GetBagSize()};
     dog.SetDirection(Direction::NORTH);
-    dogs_.emplace_back(dog);
+    dog.SetLastActive(now_);
+    AddDog(dog);
 }
 
 void GameSession::AddDog(const Dog& dog) {
-    dogs_.push_back(dog);
+    MutableDogs().push_back(dog);
+    RegisterDog();
+}
+
+void GameSession::RegisterDog() {
+    const auto& dog = dogs_->back();
+    inputs_.push_back(std::make_shared<DogInput>());
+    dog_versions_.push_back(version_);
+    dog_index_[dog.GetIdValue()] = dogs_->size() - 1;
+    idle_dogs_.push({dog.GetLastActive(), dog.GetIdValue()});
+}
+
+void GameSession::AddDogs(const std::vector<std::pair<Dog::Id::ValueType, std::string>>& dogs) {
+    const auto bag_size = map_->GetBagSize();
+    auto& session_dogs = MutableDogs();
+    session_dogs.reserve(session_dogs.size() + dogs.size());
+    inputs_.reserve(inputs_.size() + dogs.size());
+    dog_versions_.reserve(dog_versions_.size() + dogs.size());
+    for (const auto& [id, name] : dogs) {
+        auto& dog = session_dogs.emplace_back(id, name, GeneratePosition(), bag_size);
+        dog.SetDirection(Direction::NORTH);
+        dog.SetLastActive(now_);
+        RegisterDog();
+    }
 }
 
 void GameSession::RemoveDog(Dog::Id::ValueType id) {
-    for (auto it = dogs_.begin(); it != dogs_.end(); ++it) {
-        if (it->GetIdValue() == id) {
-            dogs_.erase(it);
-            break;
-        }
+    auto index = FindDog(id);
+    if (!index) {
+        return;
+    }
+    // Порядок собак не важен: на место удалённой встаёт последняя
+    auto& dogs = MutableDogs();
+    const size_t last = dogs.size() - 1;
+    if (*index != last) {
+        dogs[*index] = std::move(dogs[last]);
+        inputs_[*index] = std::move(inputs_[last]);
+        dog_versions_[*index] = dog_versions_[last];
+        dog_index_[dogs[*index].GetIdValue()] = *index;
     }
+    dogs.pop_back();
+    inputs_.pop_back();
+    dog_versions_.pop_back();
+    dog_index_.erase(id);
+    removed_dogs_.emplace_back(version_, id);
 }
 
-void GameSession::SetDogDirection(Dog::Id::ValueType id, Direction direction) {
-    auto dog_it = std::find_if(dogs_.begin(), dogs_.end(), [&id](const Dog& dog) {
-        return dog.GetIdValue() == id;
-    });
+std::optional<size_t> GameSession::FindDog(Dog::Id::ValueType id) const {
+    if (auto it = dog_index_.find(id); it != dog_index_.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
 
-    if (dog_it == dogs_.end()) {
+std::vector<Dog>& GameSession::MutableDogs() {
+    return util::DetachShared(dogs_);
+}
+
+std::map<uint64_t, LootItem>& GameSession::MutableLoots() {
+    return util::DetachShared(loots_);
+}
+
+void GameSession::SetDogDirection(Dog::Id::ValueType id, Direction direction) {
+    auto index = FindDog(id);
+    if (!index) {
         throw std::runtime_error("Dog not found");
     }
 
+    ApplyDirection(MutableDogs()[*index], direction);
+    TouchDog(*index);
+}
+
+std::shared_ptr<DogInput> GameSession::GetDogInput(Dog::Id::ValueType id) const {
+    if (auto index = FindDog(id)) {
+        return inputs_[*index];
+    }
+    return nullptr;
+}
+
+void GameSession::ApplyDirection(Dog& dog, Direction direction) const {
     // TODO: maybe refactor?
 
     if (direction == Direction::NONE) {
-        dog_it->SetSpeed({0, 0});
+        dog.SetSpeed({0, 0});
         return;
     }
 
-    dog_it->SetDirection(direction);
-    const auto s = game_->FindMap(map_id_)->GetSpeed();
+    dog.SetDirection(direction);
+    const auto s = map_->GetSpeed();
     switch (direction) {
         case Direction::NORTH:
-            dog_it->SetSpeed({0, -s});
+            dog.SetSpeed({0, -s});
+            break;
         case Direction::SOUTH:
-            dog_it->SetSpeed({0, s});
+            dog.SetSpeed({0, s});
+            break;
         case Direction::WEST:
-            dog_it->SetSpeed({-s, 0});
+            dog.SetSpeed({-s, 0});
+            break;
         case Direction::EAST:
-            dog_it->SetSpeed({s, 0});
+            dog.SetSpeed({s, 0});
+            break;
         default:
             throw std::runtime_error("Unknown direction");
     }
 }
 
+void GameSession::ApplyInputs() {
+    auto& dogs = MutableDogs();
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        if (auto direction = inputs_[i]->Take()) {
+            ApplyDirection(dogs[i], *direction);
+            TouchDog(i);
+        }
+    }
+}
+
 GameSession::Id::ValueType GameSession::GetIdValue() const {
     return *id_;
 }
@@ -85,26 +170,193 @@ Map::Id GameSession::GetMapId() const {
     return map_id_;
 }
 
-std::vector<Dog> GameSession::GetDogs() const {
-    return dogs_;
+const std::shared_ptr<const Map>& GameSession::GetMap() const {
+    return map_;
+}
+
+bool GameSession::HasDogs() const {
+    return !dogs_->empty();
+}
+
+const std::vector<Dog>& GameSession::GetDogs() const {
+    return *dogs_;
+}
+
+const Dog* GameSession::GetDog(Dog::Id::ValueType id) const {
+    auto index = FindDog(id);
+    return index ? &(*dogs_)[*index] : nullptr;
+}
+
+const std::map<uint64_t, LootItem>& GameSession::GetLoots() const {
+    return *loots_;
+}
+
+void GameSession::SetLoots(std::map<uint64_t, LootItem> loots) {
+    for (const auto& [id, loot] : *loots_) {
+        if (!loots.contains(id)) {
+            removed_loots_.emplace_back(version_, id);
+        }
+    }
+    // Снимки остаются со старыми трофеями
+    loots_ = std::make_shared<std::map<uint64_t, LootItem>>(std::move(loots));
+    loot_versions_.clear();
+    for (const auto& [id, loot] : *loots_) {
+        loot_versions_.emplace_hint(loot_versions_.end(), id, version_);
+    }
+    if (!loots_->empty()) {
+        loot_max_id_ = loots_->rbegin()->first;
+    }
+}
+
+void GameSession::SetDogs(std::vector<Dog> dogs) {
+    // Удаление и повторное добавление в одной версии читатель изменений применит верно
+    for (const auto& dog : *dogs_) {
+        removed_dogs_.emplace_back(version_, dog.GetIdValue());
+    }
+    dogs_ = std::make_shared<std::vector<Dog>>(std::move(dogs));
+    const auto& new_dogs = *dogs_;
+    inputs_.clear();
+    inputs_.reserve(new_dogs.size());
+    dog_index_.clear();
+    dog_index_.reserve(new_dogs.size());
+    std::vector<IdleDog> idle_dogs;
+    idle_dogs.reserve(new_dogs.size());
+    for (size_t i = 0; i < new_dogs.size(); ++i) {
+        inputs_.push_back(std::make_shared<DogInput>());
+        dog_index_[new_dogs[i].GetIdValue()] = i;
+        idle_dogs.push_back({new_dogs[i].GetLastActive(), new_dogs[i].GetIdValue()});
+    }
+    dog_versions_.assign(new_dogs.size(), version_);
+    idle_dogs_ = IdleQueue{std::greater<>{}, std::move(idle_dogs)};
+}
+
+void GameSession::UpsertDog(const Dog& dog) {
+    if (auto index = FindDog(dog.GetIdValue())) {
+        auto& dogs = MutableDogs();
+        // Более поздняя активность обнаружится при извлечении из очереди, более ранняя - нет
+        if (dog.GetLastActive() < dogs[*index].GetLastActive()) {
+            idle_dogs_.push({dog.GetLastActive(), dog.GetIdValue()});
+        }
+        dogs[*index] = dog;
+        TouchDog(*index);
+        return;
+    }
+    AddDog(dog);
 }
 
-std::map<uint64_t, LootItem> GameSession::GetLoots() const {
-    return loots_;
+void GameSession::UpsertLoot(const LootItem& loot) {
+    MutableLoots()[loot.id] = loot;
+    loot_max_id_ = std::max(loot_max_id_, loot.id);
+    TouchLoot(loot.id);
 }
 
-void GameSession::SetLoots(const std::map<uint64_t, LootItem>& loots) {
-    loots_ = loots;
-    if (!loots_.empty()) {
-        loot_max_id_ = loots_.rbegin()->first;
+void GameSession::RemoveLoot(uint64_t id) {
+    if (loots_->contains(id)) {
+        EraseLoot(id);
     }
 }
 
+void GameSession::TouchDog(size_t index) {
+    dog_versions_[index] = version_;
+}
+
+void GameSession::TouchLoot(uint64_t id) {
+    loot_versions_[id] = version_;
+}
+
+void GameSession::EraseLoot(uint64_t id) {
+    MutableLoots().erase(id);
+    loot_versions_.erase(id);
+    removed_loots_.emplace_back(version_, id);
+}
+
+uint64_t GameSession::GetVersion() const {
+    return version_;
+}
+
+void GameSession::CloseVersion() {
+    ++version_;
+    // Старые удаления больше никому не нужны
+    while (!removed_dogs_.empty() && removed_dogs_.front().first + TOMBSTONE_HORIZON < version_) {
+        removed_dogs_.pop_front();
+    }
+    while (!removed_loots_.empty() && removed_loots_.front().first + TOMBSTONE_HORIZON < version_) {
+        removed_loots_.pop_front();
+    }
+}
+
+std::optional<GameSession::Changes> GameSession::GetChangesSince(uint64_t since) const {
+    if (since + TOMBSTONE_HORIZON < version_) {
+        return std::nullopt;
+    }
+
+    Changes changes;
+    const auto& dogs = *dogs_;
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        if (dog_versions_[i] >= since) {
+            changes.dogs.push_back(dogs[i]);
+        }
+    }
+    for (const auto& [id, loot_version] : loot_versions_) {
+        if (loot_version >= since) {
+            changes.loots.push_back(loots_->at(id));
+        }
+    }
+    // Удаления отсортированы по версии - идём с конца до первого старого
+    for (auto it = removed_dogs_.rbegin(); it != removed_dogs_.rend() && it->first >= since; ++it) {
+        changes.removed_dogs.push_back(it->second);
+    }
+    for (auto it = removed_loots_.rbegin(); it != removed_loots_.rend() && it->first >= since; ++it) {
+        changes.removed_loots.push_back(it->second);
+    }
+    return changes;
+}
+
+std::chrono::milliseconds GameSession::GetNow() const {
+    return now_;
+}
+
+void GameSession::SetNow(std::chrono::milliseconds now) {
+    now_ = now;
+}
+
+std::chrono::milliseconds GameSession::GetNonactiveTime(const Dog& dog) const {
+    return now_ - dog.GetLastActive();
+}
+
+std::vector<Dog> GameSession::TakeRetiredDogs(std::chrono::milliseconds retirement_time) {
+    std::vector<Dog> retired;
+    while (!idle_dogs_.empty() && idle_dogs_.top().last_active + retirement_time <= now_) {
+        const auto [last_active, id] = idle_dogs_.top();
+        idle_dogs_.pop();
+
+        auto index = FindDog(id);
+        if (!index) {
+            continue; // собака уже удалена
+        }
+        const auto& dog = (*dogs_)[*index];
+        if (dog.GetLastActive() != last_active) {
+            // Двигалась после постановки в очередь - ждём новый срок
+            idle_dogs_.push({dog.GetLastActive(), id});
+            continue;
+        }
+        retired.push_back(dog);
+        RemoveDog(id);
+    }
+    return retired;
+}
+
+bool GameSession::Changes::IsEmpty() const {
+    return dogs.empty() && removed_dogs.empty() && loots.empty() && removed_loots.empty();
+}
+
 void GameSession::Tick(double tick_duration_ms) {
+    ApplyInputs();
+
     // remember start positions
     using namespace collision_detector;
     std::vector<Gatherer> gatherers;
-    for (const auto& dog : dogs_) {
+    for (const auto& dog : *dogs_) {
         Gatherer g;
         g.start_pos = {dog.GetPosition().x, dog.GetPosition().y};
         g.width = DOG_WIDTH;
@@ -114,12 +366,13 @@ void GameSession::Tick(double tick_duration_ms) {
     MoveAllDogs(tick_duration_ms);
 
     // remember end positions
-    for (size_t i = 0; i < dogs_.size(); ++i) {
-        gatherers[i].end_pos = {dogs_[i].GetPosition().x, dogs_[i].GetPosition().y};
+    auto& dogs = MutableDogs();
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        gatherers[i].end_pos = {dogs[i].GetPosition().x, dogs[i].GetPosition().y};
     }
 
     std::vector<Item> item_vec;
-    for (const auto& [loot_id, loot_item] : loots_) {
+    for (const auto& [loot_id, loot_item] : *loots_) {
         Item item{
             loot_id,
             {loot_item.pos.x, loot_item.pos.y},
@@ -129,7 +382,7 @@ void GameSession::Tick(double tick_duration_ms) {
     }
 
     constexpr uint64_t OFFICE_ITEM_TRAIT = 0;
-    for (const auto& office : game_->FindMap(map_id_)->GetOffices()) {
+    for (const auto& office : map_->GetOffices()) {
         Item item{
             OFFICE_ITEM_TRAIT,
             {static_cast<double>(office.GetPosition().x), static_cast<double>(office.GetPosition().y)},
@@ -140,12 +393,13 @@ void GameSession::Tick(double tick_duration_ms) {
 
     Provider provider{item_vec, gatherers};
     for (auto [item_id, gatherer_id, time] : FindSortedGatherEvents(provider)) {
-        auto& dog = dogs_.at(gatherer_id);
+        auto& dog = dogs.at(gatherer_id);
 
         if (item_id != OFFICE_ITEM_TRAIT) { // item is loot
-            if (loots_.contains(item_id)) {
-                if (dog.PutToBag({item_id, loots_.at(item_id).type})) {
-                    loots_.erase(item_id);
+            if (loots_->contains(item_id)) {
+                if (dog.PutToBag({item_id, loots_->at(item_id).type})) {
+                    EraseLoot(item_id);
+                    TouchDog(gatherer_id);
                 }
             }
         } else {
@@ -154,33 +408,53 @@ void GameSession::Tick(double tick_duration_ms) {
                 auto item_value = loot_data_.at(dog.GetBagContent().at(i).type).value;
                 dog.AddScore(item_value.value());
             }
-            dog.EmptyBag();
+            if (dog.EmptyBag() > 0) {
+                TouchDog(gatherer_id);
+            }
         }
     }
 
     // add new loots
     std::chrono::milliseconds ms(static_cast<int>(tick_duration_ms));
-    auto loot_cnt_to_add = game_->GetLootGenerator()->Generate(ms, loots_.size(), dogs_.size());
-    AddLoots(loot_cnt_to_add);
+    if (loot_generator_) {
+        AddLoots(loot_generator_->Generate(ms, loots_->size(), dogs.size()));
+    }
+
+    if (const auto view_radius = map_->GetViewRadius()) {
+        BuildInterestGrids(*view_radius);
+    }
+
+    CloseVersion();
 }
 
-Point2D GameSession::GeneratePosition() const {
-    const auto& roads = game_->FindMap(map_id_)->GetRoads();
+void GameSession::BuildInterestGrids(double view_radius) {
+    grid_entries_.clear();
+    for (const auto& dog : *dogs_) {
+        grid_entries_.push_back({dog.GetPosition(), dog.GetIdValue()});
+    }
+    interest_grids_.dogs.Build(grid_entries_, view_radius);
 
-    if (game_->HasRandomSpawn()) {
-        std::random_device rdev;
-        std::mt19937 generator(rdev());
-        std::uniform_int_distribution<> int_dist(0, static_cast<int>(roads.size() - 1));
+    grid_entries_.clear();
+    for (const auto& [id, loot] : *loots_) {
+        grid_entries_.push_back({loot.pos, id});
+    }
+    interest_grids_.loots.Build(grid_entries_, view_radius);
+    interest_grids_ready_ = true;
+}
+
+const GameSession::InterestGrids* GameSession::GetInterestGrids() const {
+    return interest_grids_ready_ ? &interest_grids_ : nullptr;
+}
+
+GameSession::Snapshot GameSession::GetSnapshot() const {
+    return {*id_, map_id_, now_, dogs_, loots_};
+}
 
-        const auto random_road = roads.at(int_dist(generator));
-        const auto& start = random_road.GetStart();
-        const auto& end = random_road.GetEnd();
+Point2D GameSession::GeneratePosition() {
+    const auto& roads = map_->GetRoads();
 
-        std::uniform_real_distribution<> x_dist(std::min(start.x, end.x), std::max(start.x, end.x));
-        double x = x_dist(generator);
-        std::uniform_real_distribution<> dist(std::min(start.y, end.y), std::max(start.y, end.y));
-        double y = dist(generator);
-        return {x, y};
+    if (game_->HasRandomSpawn() && !map_->GetSpawns().IsEmpty()) {
+        return map_->GetSpawns().Sample(rng_);
     }
 
     return {
@@ -202,12 +476,11 @@ void GameSession::MoveDog(model::Dog &dog, double tick_ms) {
     };
 
     if (start_position == desired_position || tick_ms == 0.0) {
-        dog.AddNonactiveTime(std::chrono::milliseconds{static_cast<unsigned>(tick_ms)});
         return;
     }
 
     // collision check
-    auto roads = game_->FindMap(map_id_)->GetRoads();
+    const auto& roads = map_->GetRoads();
     auto start_road{std::find_if(roads.begin(), roads.end(), [&start_position](const Road& road) {
         return road.GetBounds().Contains(start_position);
     })};
@@ -221,7 +494,7 @@ void GameSession::MoveDog(model::Dog &dog, double tick_ms) {
     // Не убежали со стартовой дороги
     if (start_road_rect.Contains(desired_position)) {
         dog.SetPosition(desired_position);
-        dog.ResetNonactiveTime();
+        dog.SetLastActive(now_);
         return;
     }
 
@@ -241,7 +514,7 @@ void GameSession::MoveDog(model::Dog &dog, double tick_ms) {
         auto another_road_rect = another_road->GetBounds();
         if (another_road_rect.Contains(desired_position)) {
             dog.SetPosition(desired_position);
-            dog.ResetNonactiveTime();
+            dog.SetLastActive(now_);
             return;
         }
 
@@ -252,58 +525,107 @@ void GameSession::MoveDog(model::Dog &dog, double tick_ms) {
 
     // Не нашли дорогу - тупик
     dog.SetPosition(border_point);
-    dog.ResetNonactiveTime();
+    dog.SetLastActive(now_);
     dog.SetSpeed({0.0, 0.0});
 }
 
 void GameSession::MoveAllDogs(double tick_ms) {
-    for (auto& dog : dogs_) {
+    // Двигавшиеся на этом тике собаки активны на его конец
+    now_ += std::chrono::milliseconds{static_cast<unsigned>(tick_ms)};
+    auto& dogs = MutableDogs();
+    for (size_t i = 0; i < dogs.size(); ++i) {
+        auto& dog = dogs[i];
+        const auto position = dog.GetPosition();
+        const auto speed = dog.GetSpeed();
         MoveDog(dog, tick_ms);
+        if (dog.GetPosition() != position || dog.GetSpeed() != speed) {
+            TouchDog(i);
+        }
     }
 }
 
-unsigned GameSession::GetRandomLootTypeId() const {
-    std::random_device rdev;
-    std::mt19937 gen(rdev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist(0, loot_data_.size() - 1);
-    return dist(gen);
+unsigned GameSession::GetRandomLootTypeId() {
+    std::uniform_int_distribution<unsigned> dist(0, loot_data_.size() - 1);
+    return dist(rng_);
 }
 
 // TODO: refactor loot ids
 void GameSession::AddLoots(unsigned count) {
-    for (unsigned i = 0; i < count; ++i) {
+    if (count == 0) {
+        return;
+    }
+    std::vector<Point2D> positions;
+    positions.reserve(count);
+    if (game_->HasRandomSpawn() && !map_->GetSpawns().IsEmpty()) {
+        map_->GetSpawns().Sample(rng_, count, std::back_inserter(positions));
+    } else {
+        positions.assign(count, GeneratePosition());
+    }
+    auto& loots = MutableLoots();
+    for (const auto& position : positions) {
         loot_max_id_++;
-        loots_.insert({loot_max_id_, {loot_max_id_, GetRandomLootTypeId(), GeneratePosition()}});
+        loots.insert({loot_max_id_, {loot_max_id_, GetRandomLootTypeId(), position}});
+        TouchLoot(loot_max_id_);
     }
 }
 
 /*
- * Game methods
+ * MapTable methods
  */
-void Game::AddMap(const Map& map) {
-    const size_t index = maps_.size();
-    if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
+void MapTable::Add(Map map) {
+    const size_t position = maps.size();
+    if (auto [it, inserted] = index.emplace(map.GetId(), position); !inserted) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
     } else {
         try {
-            maps_.emplace_back(map);
+            auto stored = std::make_shared<Map>(std::move(map));
+            stored->PrepareSpawns();
+            maps.emplace_back(std::move(stored));
         } catch (...) {
-            map_id_to_index_.erase(it);
+            index.erase(it);
             throw;
         }
     }
 }
 
+std::shared_ptr<const Map> MapTable::Find(const Map::Id& id) const {
+    if (auto it = index.find(id); it != index.end()) {
+        return maps.at(it->second);
+    }
+    return nullptr;
+}
+
+/*
+ * Game methods
+ */
+void Game::AddMap(Map map) {
+    // Копия при записи: загрузчики собирают таблицу сами и публикуют её одним SetMapTable
+    auto table = std::make_shared<MapTable>(*GetMapTable());
+    table->Add(std::move(map));
+    SetMapTable(std::move(table));
+}
+
+std::shared_ptr<const MapTable> Game::GetMapTable() const {
+    return map_table_.load();
+}
+
+void Game::SetMapTable(std::shared_ptr<const MapTable> table) {
+    map_table_.store(std::move(table));
+}
+
 std::shared_ptr<GameSession> Game::AddSession(const Map& map) {
-    auto sess_max_id = sessions_.empty() ? 0 : sessions_.rbegin()->first + 1;
-    auto session = std::make_shared<GameSession>(sess_max_id, shared_from_this(), map.GetId());
-    sessions_.insert({sess_max_id, session});
+    // Не по наибольшему живому id: сессию с ним могли удалить как устаревшую
+    const auto id = next_session_id_++;
+    auto session = std::make_shared<GameSession>(id, shared_from_this(), map.GetId());
+    sessions_.insert({id, session});
     return session;
 }
 
 std::shared_ptr<GameSession> Game::FindSession(const Map& map) {
-    auto session_it = std::find_if(sessions_.begin(), sessions_.end(), [&map](const auto& session) {
-        return session.second->GetMapId() == map.GetId();
+    // Сессии прежних версий карты новых игроков не принимают
+    const auto current = FindMap(map.GetId());
+    auto session_it = std::find_if(sessions_.begin(), sessions_.end(), [&current](const auto& session) {
+        return session.second->GetMap() == current;
     });
 
     if (session_it != sessions_.end()) {
@@ -313,15 +635,26 @@ std::shared_ptr<GameSession> Game::FindSession(const Map& map) {
     return nullptr;
 }
 
-std::shared_ptr<Map> Game::FindMap(const Map::Id& id) const {
-    if (auto it = map_id_to_index_.find(id); it != map_id_to_index_.end()) {
-        return std::make_shared<Map>(maps_.at(it->second));
-    }
-    return nullptr;
+void Game::DropStaleSessions() {
+    const auto table = GetMapTable();
+    std::erase_if(sessions_, [&table](const auto& session) {
+        const auto& map = session.second->GetMap();
+        return !session.second->HasDogs() && table->Find(map->GetId()) != map;
+    });
+}
+
+std::shared_ptr<const Map> Game::FindMap(const Map::Id& id) const {
+    return GetMapTable()->Find(id);
 }
 
 Game::Maps Game::GetMaps() const {
-    return maps_;
+    const auto table = GetMapTable();
+    Maps maps;
+    maps.reserve(table->maps.size());
+    for (const auto& map : table->maps) {
+        maps.push_back(*map);
+    }
+    return maps;
 }
 
 double Game::GetDefaultSpeed() const {
@@ -348,10 +681,17 @@ std::shared_ptr<GameSession> Game::GetSession(const Map& map) {
     return AddSession(map);
 }
 
-Game::Sessions Game::GetSessions() const {
+const Game::Sessions& Game::GetSessions() const {
     return sessions_;
 }
 
+std::shared_ptr<GameSession> Game::FindSession(GameSession::Id id) const {
+    if (auto it = sessions_.find(*id); it != sessions_.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
 void Game::ExternalTick(std::chrono::milliseconds tick_ms) {
     TickAllSessions(tick_ms);
 }
@@ -361,7 +701,8 @@ void Game::TickAllSessions(const std::chrono::milliseconds& tick_ms) {
     for (auto& [_, session] : sessions_) {
         session->Tick(tick_ms_double);
     }
-    tick_signal_(tick_ms);
+    DropStaleSessions();
+    tick_pipeline_.Run(tick_ms);
 }
 
 void Game::SetRandomSpawn(bool random_spawn) {
@@ -380,20 +721,40 @@ LootGenPtr Game::GetLootGenerator() const {
     return loot_generator_;
 }
 
+void Game::SetSeed(uint64_t seed) {
+    seed_ = seed;
+}
+
+uint64_t Game::GetSeed() const {
+    return seed_;
+}
+
 void Game::SetLootData(const LootData& loot_data) {
-    loot_data_ = loot_data;
+    auto table = std::make_shared<MapTable>(*GetMapTable());
+    table->loot_data = loot_data;
+    SetMapTable(std::move(table));
 }
 
 loot::MapLootTypes Game::GetLootData(const Map::Id& map_id) const {
-    return loot_data_.at(map_id);
+    return GetMapTable()->loot_data.at(map_id);
 }
 
 void Game::AddSession(std::shared_ptr<GameSession> session) {
-    sessions_[session->GetIdValue()] = session;
+    const auto id = session->GetIdValue();
+    SetNextSessionId(id + 1);
+    sessions_[id] = std::move(session);
+}
+
+GameSession::Id::ValueType Game::GetNextSessionId() const {
+    return next_session_id_;
+}
+
+void Game::SetNextSessionId(GameSession::Id::ValueType id) {
+    next_session_id_ = std::max(next_session_id_, id);
 }
 
-sig::connection Game::DoOnTick(const TickSignal::slot_type& handler) {
-    return tick_signal_.connect(handler);
+TickPipeline& Game::GetTickPipeline() {
+    return tick_pipeline_;
 }
 
 std::chrono::milliseconds Game::GetRetirementTime() const {
@@ -1,9 +1,13 @@
 #ifndef GAME_SERVER_MODEL_H
 #define GAME_SERVER_MODEL_H
 
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <queue>
 #include <random>
 #include <set>
 #include <unordered_map>
@@ -12,13 +16,16 @@
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/steady_timer.hpp>
-#include <boost/signals2.hpp>
 
 #include "geom.h"
 #include "loot.h"
 #include "model_dog.h"
 #include "model_geometry.h"
+#include "model_input.h"
+#include "random.h"
+#include "spatial_grid.h"
 #include "tagged.h"
+#include "tick_pipeline.h"
 
 namespace model {
 
@@ -40,51 +47,176 @@ struct GameState {
 using LootGenPtr = std::shared_ptr<loot::LootGenerator>;
 
 namespace net = boost::asio;
-namespace sig = boost::signals2;
 
 class GameSession {
 public:
     using Id = util::Tagged<uint64_t, GameSession>;
     explicit GameSession(Id::ValueType id, std::shared_ptr<Game> game, Map::Id map_id);
+
+    // Изменения сессии начиная с некоторой версии: текущее состояние изменённого и удалённое
+    struct Changes {
+        std::vector<Dog> dogs;
+        std::vector<Dog::Id::ValueType> removed_dogs;
+        std::vector<LootItem> loots;
+        std::vector<uint64_t> removed_loots;
+
+        [[nodiscard]] bool IsEmpty() const;
+    };
+
+    // Положения собак и трофеев на конец последнего тика для отбора по радиусу обзора
+    struct InterestGrids {
+        SpatialGrid dogs;
+        SpatialGrid loots;
+    };
+
+    // Неизменяемое состояние сессии на момент GetSnapshot, читается из любого потока
+    struct Snapshot {
+        Id::ValueType id;
+        Map::Id map_id;
+        std::chrono::milliseconds now;
+        std::shared_ptr<const std::vector<Dog>> dogs;
+        std::shared_ptr<const std::map<uint64_t, LootItem>> loots;
+    };
 public:
     void AddDog(Id::ValueType id, const std::string &name);
     void AddDog(const Dog& dog);
+    void AddDogs(const std::vector<std::pair<Dog::Id::ValueType, std::string>>& dogs);
     void RemoveDog(Dog::Id::ValueType id);
     void SetDogDirection(Dog::Id::ValueType id, Direction direction);
+    // Ввод, который будет применён к собаке в начале следующего тика
+    [[nodiscard]] std::shared_ptr<DogInput> GetDogInput(Dog::Id::ValueType id) const;
     [[nodiscard]] Id::ValueType GetIdValue() const;
     [[nodiscard]] Map::Id GetMapId() const;
-    [[nodiscard]] std::vector<Dog> GetDogs() const;
-    [[nodiscard]] std::map<uint64_t, LootItem> GetLoots() const;
-    void SetLoots(const std::map<uint64_t, LootItem>& loots);
+    // Версия карты, с которой создана сессия; перезагрузка конфига её не меняет
+    [[nodiscard]] const std::shared_ptr<const Map>& GetMap() const;
+    [[nodiscard]] bool HasDogs() const;
+    [[nodiscard]] const std::vector<Dog>& GetDogs() const;
+    // nullptr, если собаки нет в сессии
+    [[nodiscard]] const Dog* GetDog(Dog::Id::ValueType id) const;
+    [[nodiscard]] const std::map<uint64_t, LootItem>& GetLoots() const;
+    void SetLoots(std::map<uint64_t, LootItem> loots);
+    // Заменяет всех собак сессии одним вызовом, используется при восстановлении
+    void SetDogs(std::vector<Dog> dogs);
+    // Добавляет собаку или заменяет существующую с тем же id
+    void UpsertDog(const Dog& dog);
+    void UpsertLoot(const LootItem& loot);
+    void RemoveLoot(uint64_t id);
     void Tick(double tick_duration_ms);
+    // Строятся на тике, только если у карты задан радиус обзора; до первого тика nullptr
+    [[nodiscard]] const InterestGrids* GetInterestGrids() const;
+    // Без копирования: собаки и трофеи делятся со снимком, сессия скопирует их при следующем изменении
+    [[nodiscard]] Snapshot GetSnapshot() const;
+
+    /*
+     * Версии состояния. Каждое изменение помечается текущей (открытой) версией,
+     * Tick в конце закрывает её. Тот, кто прочитал изменения при версии v,
+     * в следующий раз запрашивает GetChangesSince(v) и ничего не пропустит.
+     */
+    [[nodiscard]] uint64_t GetVersion() const;
+    void CloseVersion();
+    // nullopt, если удаления с версии since уже забыты - нужно полное состояние
+    [[nodiscard]] std::optional<Changes> GetChangesSince(uint64_t since) const;
+
+    // Время сессии - сумма длительностей её тиков
+    [[nodiscard]] std::chrono::milliseconds GetNow() const;
+    // Только при восстановлении, до добавления собак
+    void SetNow(std::chrono::milliseconds now);
+    [[nodiscard]] std::chrono::milliseconds GetNonactiveTime(const Dog& dog) const;
+    // Удаляет из сессии собак, бездействующих не меньше retirement_time, и возвращает их
+    [[nodiscard]] std::vector<Dog> TakeRetiredDogs(std::chrono::milliseconds retirement_time);
 private:
-    [[nodiscard]] Point2D GeneratePosition() const;
+    // Кандидат на выбывание; запись устаревает, если собака с тех пор двигалась
+    struct IdleDog {
+        std::chrono::milliseconds last_active;
+        Dog::Id::ValueType id;
+
+        [[nodiscard]] auto operator<=>(const IdleDog&) const = default;
+    };
+    using IdleQueue = std::priority_queue<IdleDog, std::vector<IdleDog>, std::greater<>>;
+
+    [[nodiscard]] std::optional<size_t> FindDog(Dog::Id::ValueType id) const;
+    // Всё изменение собак и трофеев идёт через них: снимки не должны видеть записи
+    std::vector<Dog>& MutableDogs();
+    std::map<uint64_t, LootItem>& MutableLoots();
+    // Добавляет собаку в индекс и очередь выбывания, сама собака уже в конце dogs_
+    void RegisterDog();
+    [[nodiscard]] Point2D GeneratePosition();
+    void ApplyDirection(Dog& dog, Direction direction) const;
+    void ApplyInputs();
     void MoveDog(Dog& dog, double tick_ms);
     void MoveAllDogs(double tick_ms);
     void AddLoots(unsigned count);
-    [[nodiscard]] unsigned GetRandomLootTypeId() const;
+    [[nodiscard]] unsigned GetRandomLootTypeId();
+    void TouchDog(size_t index);
+    void TouchLoot(uint64_t id);
+    void EraseLoot(uint64_t id);
+    void BuildInterestGrids(double view_radius);
 private:
+    // Столько версий помнятся удаления
+    static constexpr uint64_t TOMBSTONE_HORIZON = 1024;
+
     Id id_;
-    std::vector<Dog> dogs_ = {};
+    // Копируются при записи, см. util::DetachShared
+    std::shared_ptr<std::vector<Dog>> dogs_ = std::make_shared<std::vector<Dog>>();
+    std::vector<std::shared_ptr<DogInput>> inputs_ = {}; // параллелен dogs_
+    std::vector<uint64_t> dog_versions_ = {}; // параллелен dogs_
+    std::unordered_map<Dog::Id::ValueType, size_t> dog_index_ = {};
+    IdleQueue idle_dogs_ = {};
+    std::chrono::milliseconds now_ = std::chrono::milliseconds(0);
     Map::Id map_id_;
     std::shared_ptr<Game> game_;
+    std::shared_ptr<const Map> map_;
     uint64_t loot_max_id_ = 1;
-    std::map<uint64_t, LootItem> loots_ = {};
+    std::shared_ptr<std::map<uint64_t, LootItem>> loots_ = std::make_shared<std::map<uint64_t, LootItem>>();
+    std::map<uint64_t, uint64_t> loot_versions_ = {};
     loot::MapLootTypes loot_data_;
+    // Свои у каждой сессии: случайные числа и время без трофеев не смешиваются между картами
+    util::Xoshiro256 rng_;
+    std::optional<loot::LootGenerator> loot_generator_;
+    InterestGrids interest_grids_;
+    bool interest_grids_ready_ = false;
+    std::vector<SpatialGrid::Entry> grid_entries_ = {};
+
+    uint64_t version_ = 1;
+    // Удаления в порядке версий: (версия, id)
+    std::deque<std::pair<uint64_t, Dog::Id::ValueType>> removed_dogs_ = {};
+    std::deque<std::pair<uint64_t, uint64_t>> removed_loots_ = {};
 };
 
-class Game : public std::enable_shared_from_this<Game> {
-    using TickSignal = sig::signal<void(std::chrono::milliseconds delta)>;
+/*
+ * Неизменяемый после публикации набор карт с их трофеями.
+ * Читатели берут снимок таблицы, перезагрузка конфига подменяет её целиком.
+ */
+struct MapTable {
     using MapIdHasher = util::TaggedHasher<Map::Id>;
     using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
-    using Maps = std::vector<Map>;
     using LootData = std::map<Map::Id, loot::MapLootTypes>;
+
+    // Бросает invalid_argument, если карта с таким id уже есть
+    void Add(Map map);
+    [[nodiscard]] std::shared_ptr<const Map> Find(const Map::Id& id) const;
+
+    std::vector<std::shared_ptr<const Map>> maps;
+    MapIdToIndex index;
+    LootData loot_data;
+};
+
+class Game : public std::enable_shared_from_this<Game> {
+    using Maps = std::vector<Map>;
+    using LootData = MapTable::LootData;
     using Sessions = std::map<GameSession::Id::ValueType, std::shared_ptr<GameSession>>;
 public:
-    void AddMap(const Map& map);
-    [[nodiscard]] std::shared_ptr<Map> FindMap(const Map::Id& id) const;
+    void AddMap(Map map);
+    [[nodiscard]] std::shared_ptr<const MapTable> GetMapTable() const;
+    /*
+     * Подменяет карты целиком. Сессии остаются на своей версии карты, новые игроки
+     * попадают в сессии новой версии, а опустевшие сессии старых версий удаляются на тике.
+     */
+    void SetMapTable(std::shared_ptr<const MapTable> table);
+    [[nodiscard]] std::shared_ptr<const Map> FindMap(const Map::Id& id) const;
     [[nodiscard]] std::shared_ptr<GameSession> GetSession(const Map& map);
-    [[nodiscard]] Sessions GetSessions() const;
+    [[nodiscard]] const Sessions& GetSessions() const;
+    [[nodiscard]] std::shared_ptr<GameSession> FindSession(GameSession::Id id) const;
     [[nodiscard]] Maps GetMaps() const;
     [[nodiscard]] double GetDefaultSpeed() const;
     void SetDefaultSpeed(double speed);
@@ -96,25 +228,36 @@ public:
     [[nodiscard]] bool HasRandomSpawn() const;
     void SetLootGenerator(LootGenPtr loot_gen);
     [[nodiscard]] LootGenPtr GetLootGenerator() const;
+    // Общее зерно; генератор сессии получает из него свой поток по id сессии
+    void SetSeed(uint64_t seed);
+    [[nodiscard]] uint64_t GetSeed() const;
     void SetLootData(const LootData& loot_data);
     [[nodiscard]] loot::MapLootTypes GetLootData(const Map::Id& map_id) const;
     void AddSession(std::shared_ptr<GameSession> session);
-    [[nodiscard]] sig::connection DoOnTick(const TickSignal::slot_type& handler);
+    // id для следующей новой сессии. id не переиспользуются: по ним идут журнал и потоки случайных чисел
+    [[nodiscard]] GameSession::Id::ValueType GetNextSessionId() const;
+    // При восстановлении; меньше уже выданных id не становится
+    void SetNextSessionId(GameSession::Id::ValueType id);
+    // Стадии, выполняемые после тика всех сессий
+    [[nodiscard]] TickPipeline& GetTickPipeline();
     [[nodiscard]] std::chrono::milliseconds GetRetirementTime() const;
     void SetRetirementTime(double retirement_seconds);
 private:
     std::shared_ptr<GameSession> AddSession(const Map& map);
     std::shared_ptr<GameSession> FindSession(const Map& map);
+    // Удаляет пустые сессии, чья карта заменена или убрана из конфига
+    void DropStaleSessions();
 private:
-    std::vector<Map> maps_;
+    // Сессии и запросы держат карты без копирования, таблица меняется только целиком
+    std::atomic<std::shared_ptr<const MapTable>> map_table_{std::make_shared<const MapTable>()};
     Sessions sessions_;
-    MapIdToIndex map_id_to_index_;
+    GameSession::Id::ValueType next_session_id_ = 0;
     double default_speed_val_ = 0.0;
     size_t default_bag_size_ = 3;
     bool start_from_random_place_ = false;
     LootGenPtr loot_generator_;
-    LootData loot_data_;
-    TickSignal tick_signal_;
+    uint64_t seed_ = std::random_device{}();
+    TickPipeline tick_pipeline_;
     std::chrono::milliseconds retirement_time_ = std::chrono::milliseconds(60'000);
 };
 
@@ -58,7 +58,7 @@ size_t Dog::EmptyBag() {
     return res;
 }
 
-std::vector<CargoItem> Dog::GetBagContent() const {
+const std::vector<CargoItem>& Dog::GetBagContent() const {
     return bag_;
 }
 
@@ -70,16 +70,12 @@ void Dog::AddScore(unsigned points) {
     score_ += points;
 }
 
-std::chrono::milliseconds Dog::GetNonactiveTime() const {
-    return nonactive_time;
+std::chrono::milliseconds Dog::GetLastActive() const {
+    return last_active_;
 }
 
-void Dog::AddNonactiveTime(std::chrono::milliseconds time) {
-    nonactive_time += time;
-}
-
-void Dog::ResetNonactiveTime() {
-    nonactive_time = std::chrono::milliseconds(0);
+void Dog::SetLastActive(std::chrono::milliseconds time) {
+    last_active_ = time;
 }
 
 void Dog::AddPlayTime(std::chrono::milliseconds time) {
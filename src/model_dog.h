@@ -42,12 +42,12 @@ public:
     [[nodiscard]] bool IsBagFull() const;
     [[nodiscard]] bool PutToBag(const CargoItem& item);
     size_t EmptyBag();
-    [[nodiscard]] std::vector<CargoItem> GetBagContent() const;
+    [[nodiscard]] const std::vector<CargoItem>& GetBagContent() const;
     [[nodiscard]] unsigned GetScore() const;
     void AddScore(unsigned points);
-    [[nodiscard]] std::chrono::milliseconds GetNonactiveTime() const;
-    void AddNonactiveTime(std::chrono::milliseconds time);
-    void ResetNonactiveTime();
+    // Время сессии, когда собака последний раз двигалась
+    [[nodiscard]] std::chrono::milliseconds GetLastActive() const;
+    void SetLastActive(std::chrono::milliseconds time);
     void AddPlayTime(std::chrono::milliseconds time);
     [[nodiscard]] std::chrono::milliseconds GetPlayTime() const;
 private:
@@ -60,7 +60,7 @@ private:
     std::vector<CargoItem> bag_;
     unsigned score_ = 0;
     std::chrono::milliseconds play_time = std::chrono::milliseconds(0);
-    std::chrono::milliseconds nonactive_time = std::chrono::milliseconds(0);
+    std::chrono::milliseconds last_active_ = std::chrono::milliseconds(0);
 };
 
 } // namespace model
@@ -98,15 +98,15 @@ std::string Map::GetName() const {
     return name_;
 }
 
-Map::Buildings Map::GetBuildings() const {
+const Map::Buildings& Map::GetBuildings() const {
     return buildings_;
 }
 
-Map::Roads Map::GetRoads() const {
+const Map::Roads& Map::GetRoads() const {
     return roads_;
 }
 
-Map::Offices Map::GetOffices() const {
+const Map::Offices& Map::GetOffices() const {
     return offices_;
 }
 
@@ -142,6 +142,76 @@ double Map::GetSpeed() const {
     return speed_val_;
 }
 
+void Map::SetViewRadius(std::optional<double> radius) {
+    if (radius && !(std::isfinite(*radius) && *radius > 0.0)) {
+        throw std::invalid_argument("viewRadius must be a positive number");
+    }
+    view_radius_ = radius;
+}
+
+void Map::PrepareSpawns() {
+    spawns_ = SpawnSampler{roads_};
+}
+
+const SpawnSampler& Map::GetSpawns() const {
+    return spawns_;
+}
+
+/*
+ * SpawnSampler methods
+ */
+SpawnSampler::SpawnSampler(const std::vector<Road>& roads) {
+    if (roads.empty()) {
+        return;
+    }
+    slots_.reserve(roads.size());
+    std::vector<double> weights;
+    weights.reserve(roads.size());
+    double total = 0.0;
+    for (const auto& road : roads) {
+        const Point2D start{static_cast<double>(road.GetStart().x), static_cast<double>(road.GetStart().y)};
+        const Vec2D delta{road.GetEnd().x - start.x, road.GetEnd().y - start.y};
+        slots_.push_back({start, delta});
+        weights.push_back(std::abs(delta.dx) + std::abs(delta.dy));
+        total += weights.back();
+    }
+    // Только точечные дороги - выбираем равновероятно
+    if (total == 0.0) {
+        std::fill(weights.begin(), weights.end(), 1.0);
+        total = static_cast<double>(weights.size());
+    }
+
+    // Метод Vose: недобравшие до среднего ячейки добираются из переполненных
+    const double scale = static_cast<double>(slots_.size()) / total;
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    for (uint32_t i = 0; i < slots_.size(); ++i) {
+        weights[i] *= scale;
+        (weights[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const auto less = small.back();
+        small.pop_back();
+        const auto more = large.back();
+        slots_[less].probability = weights[less];
+        slots_[less].alias = more;
+        weights[more] -= 1.0 - weights[less];
+        if (weights[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Остатки из-за погрешности округления считаются полными
+    for (auto i : small) {
+        slots_[i].probability = 1.0;
+        slots_[i].alias = i;
+    }
+    for (auto i : large) {
+        slots_[i].probability = 1.0;
+        slots_[i].alias = i;
+    }
+}
+
 /*
  * MapShortView methods
  */
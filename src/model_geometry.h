@@ -1,8 +1,13 @@
 #ifndef GAME_SERVER_MODEL_GEOMETRY_H
 #define GAME_SERVER_MODEL_GEOMETRY_H
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
+#include <random>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "geom.h"
 #include "tagged.h"
@@ -114,6 +119,50 @@ private:
     Offset offset_;
 };
 
+/*
+ * Выбор случайной точки на дорогах карты: дорога выбирается с вероятностью,
+ * пропорциональной её длине (таблица псевдонимов), затем точка на ней.
+ * Таблица строится один раз, выбор точки - O(1) и без выделений памяти.
+ */
+class SpawnSampler {
+public:
+    SpawnSampler() = default;
+    explicit SpawnSampler(const std::vector<Road>& roads);
+
+    [[nodiscard]] bool IsEmpty() const {
+        return slots_.empty();
+    }
+
+    template <typename Rng>
+    [[nodiscard]] Point2D Sample(Rng& rng) const {
+        const double u = std::generate_canonical<double, 53>(rng) * static_cast<double>(slots_.size());
+        const auto index = std::min(static_cast<size_t>(u), slots_.size() - 1);
+        const auto& slot = slots_[index];
+        const auto& segment = u - static_cast<double>(index) < slot.probability ? slot : slots_[slot.alias];
+        const double t = std::generate_canonical<double, 53>(rng);
+        return {segment.start.x + segment.delta.dx * t, segment.start.y + segment.delta.dy * t};
+    }
+
+    // Пачка из count точек
+    template <typename Rng, typename OutputIt>
+    OutputIt Sample(Rng& rng, size_t count, OutputIt out) const {
+        for (size_t i = 0; i < count; ++i) {
+            *out++ = Sample(rng);
+        }
+        return out;
+    }
+
+private:
+    struct Slot {
+        Point2D start;
+        Vec2D delta;
+        // Вероятность остаться в своей дороге, иначе берётся alias
+        double probability = 1.0;
+        uint32_t alias = 0;
+    };
+    std::vector<Slot> slots_;
+};
+
 class Map {
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
 public:
@@ -129,9 +178,9 @@ public:
 public:
     Id GetId() const;
     std::string GetName() const;
-    Buildings GetBuildings() const;
-    Roads GetRoads() const;
-    Offices GetOffices() const;
+    const Buildings& GetBuildings() const;
+    const Roads& GetRoads() const;
+    const Offices& GetOffices() const;
     void AddRoad(const Road& road);
     void AddBuilding(const Building& building);
     void AddOffice(Office office);
@@ -139,6 +188,13 @@ public:
     [[nodiscard]] double GetSpeed() const;
     void SetBagSize(size_t bag_size) { bag_size_ = bag_size; }
     [[nodiscard]] size_t GetBagSize() const { return bag_size_; }
+    // Радиус, в котором игрок видит собак и трофеи; без него видна вся сессия.
+    // Бросает invalid_argument, если радиус не положительное конечное число
+    void SetViewRadius(std::optional<double> radius);
+    [[nodiscard]] std::optional<double> GetViewRadius() const { return view_radius_; }
+    // Строит таблицу точек появления, вызывается после добавления всех дорог
+    void PrepareSpawns();
+    [[nodiscard]] const SpawnSampler& GetSpawns() const;
 private:
     Id id_;
     std::string name_;
@@ -148,6 +204,8 @@ private:
     OfficeIdToIndex warehouse_id_to_index_;
     double speed_val_;
     size_t bag_size_ = 3;
+    std::optional<double> view_radius_;
+    SpawnSampler spawns_;
 };
 
 class MapShortView {
@@ -0,0 +1,29 @@
+#include "model_input.h"
+
+namespace model {
+
+void DogInput::Post(Direction direction) noexcept {
+    auto state = state_.load(std::memory_order_relaxed);
+    uint64_t next_state;
+    do {
+        const auto next_seq = (state >> DIRECTION_BITS) + 1;
+        next_state = (next_seq << DIRECTION_BITS) | static_cast<uint64_t>(direction);
+    } while (!state_.compare_exchange_weak(state, next_state,
+                                           std::memory_order_release, std::memory_order_relaxed));
+}
+
+std::optional<Direction> DogInput::Take() noexcept {
+    const auto state = state_.load(std::memory_order_acquire);
+    const auto seq = state >> DIRECTION_BITS;
+    if (seq == taken_seq_) {
+        return std::nullopt;
+    }
+    taken_seq_ = seq;
+    return static_cast<Direction>(state & DIRECTION_MASK);
+}
+
+uint64_t DogInput::GetSequence() const noexcept {
+    return state_.load(std::memory_order_relaxed) >> DIRECTION_BITS;
+}
+
+} // namespace model
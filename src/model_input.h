@@ -0,0 +1,34 @@
+#ifndef GAME_SERVER_MODEL_INPUT_H
+#define GAME_SERVER_MODEL_INPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
+#include "model_geometry.h"
+
+namespace model {
+
+/*
+ * Почтовый ящик ввода собаки.
+ * Post может вызываться из любого потока без блокировок: побеждает последняя запись,
+ * каждая запись получает новый порядковый номер.
+ * Take вызывается только из потока симуляции в начале тика.
+ */
+class DogInput {
+public:
+    void Post(Direction direction) noexcept;
+    [[nodiscard]] std::optional<Direction> Take() noexcept;
+    [[nodiscard]] uint64_t GetSequence() const noexcept;
+private:
+    static constexpr unsigned DIRECTION_BITS = 8;
+    static constexpr uint64_t DIRECTION_MASK = (uint64_t{1} << DIRECTION_BITS) - 1;
+
+    // старшие биты - порядковый номер записи, младшие - направление
+    std::atomic<uint64_t> state_{0};
+    uint64_t taken_seq_ = 0;
+};
+
+} // namespace model
+
+#endif //GAME_SERVER_MODEL_INPUT_H
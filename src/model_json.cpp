@@ -67,19 +67,21 @@ MapSettings tag_invoke(json::value_to_tag<MapSettings>&, const json::value& val)
         std::string{val.at("name").as_string()}
     };
 
-    for (const auto& road : json::value_to<std::vector<Road>>(val.at("roads"))) {
-        game_map.AddRoad(road);
+    // Элементы переносятся в карту по одному, без промежуточных векторов
+    for (const auto& road : val.at("roads").as_array()) {
+        game_map.AddRoad(json::value_to<Road>(road));
     }
-    for (const auto& building : json::value_to<std::vector<Building>>(val.at("buildings"))) {
-        game_map.AddBuilding(building);
+    for (const auto& building : val.at("buildings").as_array()) {
+        game_map.AddBuilding(json::value_to<Building>(building));
     }
-    for (const auto& office : json::value_to<std::vector<Office>>(val.at("offices"))) {
-        game_map.AddOffice(office);
+    for (const auto& office : val.at("offices").as_array()) {
+        game_map.AddOffice(json::value_to<Office>(office));
     }
 
     loot::MapLootTypes loots;
-    auto loots_obj = val.at("lootTypes").as_array();
-    for (const auto& loot : loots_obj) {
+    const auto& loots_arr = val.at("lootTypes").as_array();
+    loots.reserve(loots_arr.size());
+    for (const auto& loot : loots_arr) {
         loots.emplace_back(json::value_to<loot::LootType>(loot));
     }
 
@@ -93,11 +95,17 @@ MapSettings tag_invoke(json::value_to_tag<MapSettings>&, const json::value& val)
         bag_size = val.at("defaultBagCapacity").as_int64();
     }
 
+    std::optional<double> view_radius = std::nullopt;
+    if (val.as_object().contains("viewRadius")) {
+        view_radius = json::value_to<double>(val.at("viewRadius"));
+    }
+
     return {
-        game_map,
-        loots,
+        std::move(game_map),
+        std::move(loots),
         speed,
-        bag_size
+        bag_size,
+        view_radius
     };
 }
 
@@ -165,6 +173,9 @@ void tag_invoke(json::value_from_tag, json::value& val, const std::pair<Map, loo
         {"offices", pair.first.GetOffices()},
         {"lootTypes", pair.second}
     };
+    if (const auto view_radius = pair.first.GetViewRadius()) {
+        val.as_object()["viewRadius"] = *view_radius;
+    }
 }
 
 void tag_invoke(json::value_from_tag, json::value &val, const Point2D &pos) {
@@ -197,6 +208,27 @@ void tag_invoke(json::value_from_tag, json::value &val, const Direction &directi
     }
 }
 
+std::optional<Direction> ParseDirection(std::string_view dir) {
+    if (dir.empty()) {
+        return Direction::NONE;
+    }
+    if (dir.size() != 1) {
+        return std::nullopt;
+    }
+    switch (dir.front()) {
+        case 'U':
+            return Direction::NORTH;
+        case 'D':
+            return Direction::SOUTH;
+        case 'L':
+            return Direction::WEST;
+        case 'R':
+            return Direction::EAST;
+        default:
+            return std::nullopt;
+    }
+}
+
 void tag_invoke(json::value_from_tag, json::value& val, const CargoItem& cargo_item) {
     val = {
         {"id", cargo_item.id},
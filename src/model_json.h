@@ -1,6 +1,9 @@
 #ifndef GAME_SERVER_MODEL_JSON_H
 #define GAME_SERVER_MODEL_JSON_H
 
+#include <optional>
+#include <string_view>
+
 #include "loot.h"
 
 namespace model {
@@ -10,6 +13,7 @@ struct MapSettings {
     loot::MapLootTypes loots;
     std::optional<double> speed;
     std::optional<size_t> bag_size = 3;
+    std::optional<double> view_radius;
 };
 
 namespace json = boost::json;
@@ -30,6 +34,8 @@ void tag_invoke(json::value_from_tag, json::value& val, const std::pair<Map, loo
 void tag_invoke(json::value_from_tag, json::value& val, const Point2D& pos);
 void tag_invoke(json::value_from_tag, json::value& val, const Vec2D& speed);
 void tag_invoke(json::value_from_tag, json::value& val, const Direction& direction);
+// Обратное к сериализации Direction преобразование: "U", "D", "L", "R" или ""
+std::optional<Direction> ParseDirection(std::string_view dir);
 void tag_invoke(json::value_from_tag, json::value& val, const CargoItem& cargo_item);
 void tag_invoke(json::value_from_tag, json::value& val, const Dog& dog);
 
@@ -0,0 +1,81 @@
+#ifndef GAME_SERVER_RANDOM_H
+#define GAME_SERVER_RANDOM_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace util {
+
+// Перемешивает 64-битное значение; используется для раскрутки зерна
+constexpr uint64_t SplitMix64(uint64_t& state) noexcept {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Генератор xoshiro256**: 32 байта состояния, без системных вызовов.
+ * Удовлетворяет UniformRandomBitGenerator, поэтому работает со стандартными распределениями.
+ * Непредсказуемости не даёт - для токенов не годится.
+ */
+class Xoshiro256 {
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed = 0) noexcept {
+        Seed(seed);
+    }
+
+    // Независимый поток номер stream из общего зерна
+    Xoshiro256(uint64_t seed, uint64_t stream) noexcept {
+        uint64_t mixed = seed;
+        mixed = SplitMix64(mixed) ^ stream;
+        Seed(mixed);
+    }
+
+    void Seed(uint64_t seed) noexcept {
+        for (auto& word : state_) {
+            word = SplitMix64(seed);
+        }
+    }
+
+    static constexpr result_type min() noexcept {
+        return 0;
+    }
+
+    static constexpr result_type max() noexcept {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()() noexcept {
+        const uint64_t result = Rotl(state_[1] * 5, 7) * 9;
+        const uint64_t t = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= t;
+        state_[3] = Rotl(state_[3], 45);
+        return result;
+    }
+
+    // Равномерно в [0, 1)
+    double NextDouble() noexcept {
+        return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+    }
+
+    bool operator==(const Xoshiro256&) const = default;
+
+private:
+    static constexpr uint64_t Rotl(uint64_t x, int k) noexcept {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    std::array<uint64_t, 4> state_{};
+};
+
+} // namespace util
+
+#endif //GAME_SERVER_RANDOM_H
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <boost/asio/post.hpp>
+#include <boost/crc.hpp>
+
+#include "record_log.h"
+
+namespace db {
+
+namespace bip = boost::interprocess;
+
+namespace {
+
+constexpr char LOG_MAGIC[8] = {'G', 'S', 'R', 'E', 'C', 'L', 'G', '1'};
+constexpr size_t BEGIN_OFFSET = sizeof(LOG_MAGIC);
+constexpr size_t END_OFFSET = BEGIN_OFFSET + sizeof(uint64_t);
+constexpr size_t HEADER_SIZE = END_OFFSET + sizeof(uint64_t);
+constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+constexpr size_t RECORD_FIXED_SIZE = sizeof(uint32_t) + sizeof(int64_t);
+constexpr size_t INITIAL_CAPACITY = size_t{1} << 20;
+
+// Поля в файле не выровнены, поэтому читаем и пишем через memcpy
+template <typename T>
+T Load(const char* src) {
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+template <typename T>
+char* Store(char* dst, T value) {
+    std::memcpy(dst, &value, sizeof(T));
+    return dst + sizeof(T);
+}
+
+uint32_t Checksum(const char* data, size_t size) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+size_t FrameSize(const domain::RetiredDog& dog) {
+    return FRAME_HEADER_SIZE + RECORD_FIXED_SIZE + dog.name.size();
+}
+
+} // namespace
+
+/*
+ * RecordLog methods
+ */
+RecordLog::RecordLog(std::filesystem::path path)
+        : path_{std::move(path)} {
+    namespace fs = std::filesystem;
+    if (!fs::exists(path_) || fs::file_size(path_) < HEADER_SIZE) {
+        std::ofstream{path_, std::ios::binary | std::ios::trunc};
+        fs::resize_file(path_, INITIAL_CAPACITY);
+        Map();
+        std::memcpy(region_.get_address(), LOG_MAGIC, sizeof(LOG_MAGIC));
+        SetField(BEGIN_OFFSET, HEADER_SIZE);
+        SetField(END_OFFSET, HEADER_SIZE);
+        return;
+    }
+
+    Map();
+    if (std::memcmp(region_.get_address(), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+        throw std::runtime_error("Not a records log: " + path_.string());
+    }
+    const size_t end = std::min<size_t>(GetField(END_OFFSET), region_.get_size());
+    const size_t begin = std::clamp<size_t>(GetField(BEGIN_OFFSET), HEADER_SIZE, end);
+    domain::Retirees records;
+    const size_t valid_end = Scan(begin, end, &records);
+    if (valid_end != GetField(END_OFFSET)) {
+        SetField(END_OFFSET, valid_end);
+    }
+    record_count_ = records.size();
+}
+
+void RecordLog::Map() {
+    mapping_ = bip::file_mapping{path_.c_str(), bip::read_write};
+    region_ = bip::mapped_region{mapping_, bip::read_write};
+}
+
+void RecordLog::Grow(size_t min_capacity) {
+    const size_t capacity = std::max(region_.get_size() * 2, min_capacity);
+    region_ = bip::mapped_region{};
+    std::filesystem::resize_file(path_, capacity);
+    Map();
+}
+
+uint64_t RecordLog::GetField(size_t offset) const {
+    return Load<uint64_t>(static_cast<const char*>(region_.get_address()) + offset);
+}
+
+void RecordLog::SetField(size_t offset, uint64_t value) {
+    Store(static_cast<char*>(region_.get_address()) + offset, value);
+    region_.flush(0, HEADER_SIZE, false);
+}
+
+size_t RecordLog::Scan(size_t begin, size_t end, domain::Retirees* records) const {
+    const char* data = static_cast<const char*>(region_.get_address());
+    size_t pos = begin;
+    while (pos + FRAME_HEADER_SIZE + RECORD_FIXED_SIZE <= end) {
+        const auto payload_size = Load<uint32_t>(data + pos);
+        const auto checksum = Load<uint32_t>(data + pos + sizeof(uint32_t));
+        const char* payload = data + pos + FRAME_HEADER_SIZE;
+        if (payload_size < RECORD_FIXED_SIZE || pos + FRAME_HEADER_SIZE + payload_size > end
+            || Checksum(payload, payload_size) != checksum) {
+            break;
+        }
+
+        domain::RetiredDog dog;
+        dog.score = Load<uint32_t>(payload);
+        dog.game_duration = std::chrono::milliseconds{Load<int64_t>(payload + sizeof(uint32_t))};
+        dog.name.assign(payload + RECORD_FIXED_SIZE, payload_size - RECORD_FIXED_SIZE);
+        records->push_back(std::move(dog));
+        pos += FRAME_HEADER_SIZE + payload_size;
+    }
+    return pos;
+}
+
+void RecordLog::Append(const domain::Retirees& dogs) {
+    if (dogs.empty()) {
+        return;
+    }
+
+    std::lock_guard lock{mutex_};
+    const size_t begin = GetField(END_OFFSET);
+    size_t batch_size = 0;
+    for (const auto& dog : dogs) {
+        batch_size += FrameSize(dog);
+    }
+    if (begin + batch_size > region_.get_size()) {
+        Grow(begin + batch_size);
+    }
+
+    char* out = static_cast<char*>(region_.get_address()) + begin;
+    for (const auto& dog : dogs) {
+        char* payload = out + FRAME_HEADER_SIZE;
+        char* name = Store(Store(payload, static_cast<uint32_t>(dog.score)), static_cast<int64_t>(dog.game_duration.count()));
+        std::memcpy(name, dog.name.data(), dog.name.size());
+        const auto payload_size = static_cast<uint32_t>(RECORD_FIXED_SIZE + dog.name.size());
+        Store(Store(out, payload_size), Checksum(payload, payload_size));
+        out += FRAME_HEADER_SIZE + payload_size;
+    }
+    // Сначала данные, потом конец журнала в заголовке: при падении между ними пачка просто теряется
+    region_.flush(begin, batch_size, false);
+    SetField(END_OFFSET, begin + batch_size);
+    record_count_ += dogs.size();
+}
+
+RecordLog::Contents RecordLog::ReadAll() const {
+    std::lock_guard lock{mutex_};
+    Contents contents;
+    contents.end = Scan(GetField(BEGIN_OFFSET), GetField(END_OFFSET), &contents.records);
+    return contents;
+}
+
+void RecordLog::Consume(const Contents& contents) {
+    std::lock_guard lock{mutex_};
+    if (contents.end >= GetField(END_OFFSET)) {
+        // Журнал пуст - пишем снова с начала файла
+        SetField(BEGIN_OFFSET, HEADER_SIZE);
+        SetField(END_OFFSET, HEADER_SIZE);
+        record_count_ = 0;
+    } else {
+        SetField(BEGIN_OFFSET, contents.end);
+        record_count_ -= std::min(record_count_, contents.records.size());
+    }
+}
+
+size_t RecordLog::GetRecordCount() const {
+    std::lock_guard lock{mutex_};
+    return record_count_;
+}
+
+/*
+ * EmbeddedRecordStore methods
+ */
+EmbeddedRecordStore::EmbeddedRecordStore(std::filesystem::path path)
+        : log_{std::move(path)} {
+    auto records = log_.ReadAll().records;
+    index_.insert(std::make_move_iterator(records.begin()), std::make_move_iterator(records.end()));
+}
+
+void EmbeddedRecordStore::SaveBatch(const domain::Retirees& dogs) {
+    if (dogs.empty()) {
+        return;
+    }
+    log_.Append(dogs);
+
+    // Узлы выделяются до блокировки, под ней они только перевешиваются в индекс - O(k log N)
+    Index batch{dogs.begin(), dogs.end()};
+    std::unique_lock lock{index_mutex_};
+    index_.merge(batch);
+}
+
+domain::Retirees EmbeddedRecordStore::GetRetiredDogs(const domain::RecordsQuery& query) {
+    std::shared_lock lock{index_mutex_};
+    auto first = index_.begin();
+    if (query.after) {
+        const auto& after = *query.after;
+        first = index_.lower_bound(domain::RetiredDog{after.name, after.score, after.game_duration});
+        for (unsigned skipped = 0; skipped < after.skip && first != index_.end() && domain::IsSameRank(*first, after); ++skipped) {
+            ++first;
+        }
+    } else {
+        const auto start = std::min(static_cast<size_t>(std::max(query.start.value_or(0), 0)), index_.size());
+        first = std::next(first, static_cast<std::ptrdiff_t>(start));
+    }
+
+    domain::Retirees records;
+    const auto max_items = query.max_items ? static_cast<size_t>(std::max(*query.max_items, 0)) : index_.size();
+    for (; first != index_.end() && records.size() < max_items; ++first) {
+        records.push_back(*first);
+    }
+    return records;
+}
+
+void EmbeddedRecordStore::DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) {
+    net::post(query_threads_, [this, query = std::move(query), callback = std::move(callback)]() mutable {
+        std::exception_ptr error;
+        domain::Retirees records;
+        try {
+            records = GetRetiredDogs(query);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        callback(error, std::move(records));
+    });
+}
+
+} // namespace db
@@ -0,0 +1,85 @@
+#ifndef GAME_SERVER_RECORD_LOG_H
+#define GAME_SERVER_RECORD_LOG_H
+
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+#include <boost/asio/thread_pool.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "domain.h"
+#include "record_store.h"
+
+namespace db {
+
+/*
+ * Файл-журнал рекордов, отображённый в память. Записи только дописываются в конец,
+ * прочитанные можно снять с начала.
+ * Формат файла: заголовок (сигнатура, начало и конец данных), затем кадры
+ * [размер][crc32][score][play_time_ms][имя]. Недописанный хвост отбрасывается при открытии.
+ */
+class RecordLog {
+public:
+    struct Contents {
+        domain::Retirees records;
+        // Позиция для Consume
+        size_t end = 0;
+    };
+
+    explicit RecordLog(std::filesystem::path path);
+
+    // Возвращается после сброса данных на диск
+    void Append(const domain::Retirees& dogs);
+    [[nodiscard]] Contents ReadAll() const;
+    // Снимает с начала журнала записи, прочитанные ReadAll
+    void Consume(const Contents& contents);
+    [[nodiscard]] size_t GetRecordCount() const;
+private:
+    void Map();
+    void Grow(size_t min_capacity);
+    [[nodiscard]] uint64_t GetField(size_t offset) const;
+    void SetField(size_t offset, uint64_t value);
+    // Проверяет кадры от begin до end, возвращает конец последнего целого кадра
+    [[nodiscard]] size_t Scan(size_t begin, size_t end, domain::Retirees* records) const;
+private:
+    std::filesystem::path path_;
+    mutable std::mutex mutex_;
+    boost::interprocess::file_mapping mapping_;
+    boost::interprocess::mapped_region region_;
+    size_t record_count_ = 0;
+};
+
+/*
+ * Встроенное хранилище рекордов без сети: RecordLog на диске
+ * и упорядоченный индекс всех записей в памяти. Вставка пачки и поиск по курсору
+ * логарифмические; смещение start проходится по индексу линейно.
+ */
+class EmbeddedRecordStore final : public RecordStore {
+public:
+    explicit EmbeddedRecordStore(std::filesystem::path path);
+
+    void SaveBatch(const domain::Retirees& dogs) override;
+    domain::Retirees GetRetiredDogs(const domain::RecordsQuery& query) override;
+    [[nodiscard]] net::any_io_executor GetExecutor() override {
+        return query_threads_.get_executor();
+    }
+protected:
+    void DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) override;
+private:
+    RecordLog log_;
+
+    mutable std::shared_mutex index_mutex_;
+    // Все записи в порядке domain::RecordOrder
+    using Index = std::multiset<domain::RetiredDog, domain::RecordOrder>;
+    Index index_;
+
+    net::thread_pool query_threads_{1};
+};
+
+} // namespace db
+
+#endif //GAME_SERVER_RECORD_LOG_H
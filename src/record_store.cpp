@@ -0,0 +1,230 @@
+#include "record_store.h"
+#include "record_log.h"
+#include "logger.h"
+
+namespace db {
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// Как часто фоновые потоки проверяют очередь и состояние размыкателя
+constexpr auto POLL_PERIOD = 100ms;
+
+} // namespace
+
+/*
+ * RecordWriter methods
+ */
+RecordWriter::RecordWriter(RecordStore& store, RecordLog& spool, Options options)
+        : store_{store}
+        , spool_{spool}
+        , options_{options}
+        , guard_{[this](const std::stop_token& stop) { Guard(stop); }}
+        , worker_{[this](const std::stop_token& stop) { Run(stop); }} {
+    spool_gauge_.Set(static_cast<double>(spool_.GetRecordCount()));
+}
+
+RecordWriter::~RecordWriter() {
+    Stop();
+}
+
+void RecordWriter::Save(domain::Retirees dogs) {
+    if (dogs.empty()) {
+        return;
+    }
+    {
+        std::lock_guard lock{mutex_};
+        if (queue_.empty()) {
+            queue_ = std::move(dogs);
+            oldest_queued_ = Clock::now();
+        } else {
+            queue_.insert(queue_.end(), std::make_move_iterator(dogs.begin()), std::make_move_iterator(dogs.end()));
+        }
+        queue_gauge_.Set(static_cast<double>(queue_.size()));
+    }
+    cond_var_.notify_all();
+}
+
+void RecordWriter::Stop() {
+    // Сначала сторож, чтобы он не забрал очередь у дописывающего её потока записи
+    if (guard_.joinable()) {
+        guard_.request_stop();
+        guard_.join();
+    }
+    if (worker_.joinable()) {
+        worker_.request_stop();
+        worker_.join();
+    }
+}
+
+RecordWriter::BreakerState RecordWriter::GetBreakerState() const {
+    std::lock_guard lock{mutex_};
+    return state_;
+}
+
+void RecordWriter::SetState(BreakerState state) {
+    state_ = state;
+    state_gauge_.Set(static_cast<double>(state));
+}
+
+void RecordWriter::OpenBreaker() {
+    if (state_ != BreakerState::OPEN) {
+        trips_.Add();
+        logger::Logger::log_json("records store is down", {{"spooled", spool_.GetRecordCount()}});
+    }
+    SetState(BreakerState::OPEN);
+    opened_at_ = Clock::now();
+}
+
+bool RecordWriter::IsStoreDown() const {
+    return state_ != BreakerState::CLOSED;
+}
+
+void RecordWriter::SpoolQueue(std::unique_lock<std::mutex>& lock) {
+    domain::Retirees batch;
+    batch.swap(queue_);
+    queue_gauge_.Set(0);
+    lock.unlock();
+
+    try {
+        spool_.Append(batch);
+        spooled_.Add(batch.size());
+        spool_gauge_.Set(static_cast<double>(spool_.GetRecordCount()));
+        lock.lock();
+    } catch (const std::exception& ex) {
+        logger::Logger::log_json("records spool error", {{"error", ex.what()}, {"count", batch.size()}});
+        // Остаётся только держать записи в памяти
+        lock.lock();
+        queue_.insert(queue_.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        queue_gauge_.Set(static_cast<double>(queue_.size()));
+    }
+}
+
+bool RecordWriter::Request(std::string_view name, size_t count, const std::function<void()>& request) {
+    {
+        std::lock_guard lock{mutex_};
+        in_flight_since_ = Clock::now();
+    }
+    bool succeeded = true;
+    try {
+        request();
+    } catch (const std::exception& ex) {
+        logger::Logger::log_json(name, {{"error", ex.what()}, {"count", count}});
+        succeeded = false;
+    }
+
+    std::lock_guard lock{mutex_};
+    in_flight_since_.reset();
+    if (succeeded) {
+        SetState(BreakerState::CLOSED);
+    } else {
+        OpenBreaker();
+    }
+    return succeeded;
+}
+
+bool RecordWriter::Write(const domain::Retirees& batch) {
+    return Request("records save error", batch.size(), [this, &batch] {
+        store_.SaveBatch(batch);
+    });
+}
+
+bool RecordWriter::Ping() {
+    return Request("records ping error", 0, [this] {
+        store_.Ping();
+    });
+}
+
+bool RecordWriter::Replay() {
+    auto contents = spool_.ReadAll();
+    if (contents.records.empty()) {
+        return true;
+    }
+    if (!Write(contents.records)) {
+        return false;
+    }
+    spool_.Consume(contents);
+    replayed_.Add(contents.records.size());
+    spool_gauge_.Set(static_cast<double>(spool_.GetRecordCount()));
+    return true;
+}
+
+void RecordWriter::Run(const std::stop_token& stop) {
+    while (!stop.stop_requested()) {
+        domain::Retirees batch;
+        bool replay = false;
+        bool ping = false;
+        {
+            std::unique_lock lock{mutex_};
+            cond_var_.wait_for(lock, stop, POLL_PERIOD, [this] {
+                return state_ == BreakerState::CLOSED && !queue_.empty();
+            });
+            if (state_ == BreakerState::OPEN && Clock::now() - opened_at_ >= options_.retry_delay) {
+                SetState(BreakerState::HALF_OPEN);
+            }
+            const bool spooled = spool_.GetRecordCount() > 0;
+            // В HALF_OPEN пробой служит spool, без него - очередь, а без неё - Ping
+            if (state_ == BreakerState::CLOSED || (state_ == BreakerState::HALF_OPEN && !spooled)) {
+                batch.swap(queue_);
+                queue_gauge_.Set(0);
+            }
+            replay = spooled && state_ != BreakerState::OPEN;
+            ping = state_ == BreakerState::HALF_OPEN && !spooled && batch.empty();
+        }
+
+        if (!batch.empty() && !Write(batch)) {
+            std::unique_lock lock{mutex_};
+            queue_.insert(queue_.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            SpoolQueue(lock);
+            continue;
+        }
+        // Пробная запись после отказа или остатки spool с прошлого запуска
+        if (replay) {
+            Replay();
+        } else if (ping) {
+            Ping();
+        }
+    }
+
+    // Остановка: дописываем очередь в хранилище, если оно доступно, иначе в spool
+    std::unique_lock lock{mutex_};
+    if (queue_.empty()) {
+        return;
+    }
+    if (!IsStoreDown()) {
+        domain::Retirees batch;
+        batch.swap(queue_);
+        lock.unlock();
+        if (Write(batch)) {
+            return;
+        }
+        lock.lock();
+        queue_.insert(queue_.begin(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    }
+    SpoolQueue(lock);
+}
+
+void RecordWriter::Guard(const std::stop_token& stop) {
+    std::unique_lock lock{mutex_};
+    while (!stop.stop_requested()) {
+        cond_var_.wait_for(lock, stop, POLL_PERIOD, [this] {
+            return queue_.size() >= options_.max_queue;
+        });
+        if (stop.stop_requested()) {
+            return;
+        }
+
+        const auto now = Clock::now();
+        // Запрос к хранилищу завис - не ждём его, дальше пишем в spool
+        if (in_flight_since_ && now - *in_flight_since_ > options_.max_delay) {
+            OpenBreaker();
+        }
+        const bool overdue = !queue_.empty() && now - oldest_queued_ > options_.max_delay;
+        if (!queue_.empty() && (IsStoreDown() || queue_.size() >= options_.max_queue || overdue)) {
+            SpoolQueue(lock);
+        }
+    }
+}
+
+}
@@ -0,0 +1,153 @@
+#ifndef GAME_SERVER_RECORD_STORE_H
+#define GAME_SERVER_RECORD_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include "domain.h"
+#include "metrics.h"
+
+namespace db {
+
+namespace net = boost::asio;
+
+/*
+ * Хранилище рекордов. Порядок и постраничная выдача у всех реализаций одинаковые:
+ * domain::RecordOrder, смещение start или курсор after
+ */
+class RecordStore {
+public:
+    virtual ~RecordStore() = default;
+
+    // Пишет все записи разом
+    virtual void SaveBatch(const domain::Retirees& dogs) = 0;
+    virtual domain::Retirees GetRetiredDogs(const domain::RecordsQuery& query) = 0;
+    // Проверяет, что хранилище отвечает; бросает исключение, если нет
+    virtual void Ping() {
+        GetRetiredDogs({std::nullopt, std::nullopt, 1});
+    }
+
+    /*
+     * Сигнатура завершения void(std::exception_ptr, domain::Retirees),
+     * обработчик вызывается через свой executor
+     */
+    template <typename CompletionToken>
+    auto AsyncGetRetiredDogs(domain::RecordsQuery query, CompletionToken&& token) {
+        return net::async_initiate<CompletionToken, void(std::exception_ptr, domain::Retirees)>(
+            [this, query = std::move(query)](auto handler) mutable {
+                auto work = net::make_work_guard(net::get_associated_executor(handler));
+                DoAsyncGetRetiredDogs(std::move(query),
+                    [handler = std::move(handler), work](std::exception_ptr error, domain::Retirees records) mutable {
+                        net::post(work.get_executor(), [handler = std::move(handler), error, records = std::move(records)]() mutable {
+                            handler(error, std::move(records));
+                        });
+                    });
+            }, token);
+    }
+
+    // Executor, на котором хранилище выполняет запросы
+    [[nodiscard]] virtual net::any_io_executor GetExecutor() = 0;
+protected:
+    using Callback = std::move_only_function<void(std::exception_ptr, domain::Retirees)>;
+    // callback можно вызвать в любом потоке, в том числе сразу
+    virtual void DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) = 0;
+};
+
+class RecordLog;
+
+/*
+ * Отложенная запись рекордов.
+ * Save только кладёт записи в очередь, фоновый поток забирает всё накопившееся
+ * и пишет пачкой. Stop (и деструктор) дописывает очередь до конца.
+ *
+ * Если хранилище не отвечает или очередь растёт, записи уходят в локальный
+ * журнал spool, а хранилище считается недоступным (размыкатель открыт).
+ * После паузы хранилище пробуется: переписывается spool, а если он пуст - первая пачка
+ * очереди или, без неё, Ping. Удалось - размыкатель замкнут, нет - снова открыт.
+ * Повтор после падения между записью в хранилище и очисткой spool может задублировать пачку.
+ */
+class RecordWriter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Больше записей в очереди - сбрасываем её в spool
+        size_t max_queue = 10'000;
+        // Столько может ждать запись в очереди или висеть запрос к хранилищу
+        Clock::duration max_delay = std::chrono::seconds{2};
+        // Пауза перед пробной записью после отказа хранилища
+        Clock::duration retry_delay = std::chrono::seconds{5};
+    };
+
+    enum class BreakerState {
+        CLOSED,
+        OPEN,
+        HALF_OPEN
+    };
+
+    RecordWriter(RecordStore& store, RecordLog& spool, Options options);
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+    ~RecordWriter();
+
+    void Save(domain::Retirees dogs);
+    void Stop();
+    [[nodiscard]] BreakerState GetBreakerState() const;
+private:
+    void Run(const std::stop_token& stop);
+    // Следит за очередью и зависшими запросами, сбрасывает очередь в spool
+    void Guard(const std::stop_token& stop);
+    // Вызываются под захваченным mutex_
+    void SetState(BreakerState state);
+    void OpenBreaker();
+    [[nodiscard]] bool IsStoreDown() const;
+    // Отдаёт очередь в spool, на время записи отпускает lock
+    void SpoolQueue(std::unique_lock<std::mutex>& lock);
+    // Выполняет запрос к хранилищу и обновляет размыкатель, false при ошибке
+    bool Request(std::string_view name, size_t count, const std::function<void()>& request);
+    bool Write(const domain::Retirees& batch);
+    bool Ping();
+    // Переписывает spool в хранилище, true при успехе
+    bool Replay();
+private:
+    RecordStore& store_;
+    RecordLog& spool_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any cond_var_;
+    domain::Retirees queue_;
+    Clock::time_point oldest_queued_;
+    // Начало текущего запроса к хранилищу
+    std::optional<Clock::time_point> in_flight_since_;
+    BreakerState state_ = BreakerState::CLOSED;
+    Clock::time_point opened_at_;
+
+    metrics::Gauge& state_gauge_ = metrics::Registry::get_instance().GetGauge("records.breaker.state");
+    metrics::Counter& trips_ = metrics::Registry::get_instance().GetCounter("records.breaker.trips");
+    metrics::Gauge& queue_gauge_ = metrics::Registry::get_instance().GetGauge("records.queue.size");
+    metrics::Gauge& spool_gauge_ = metrics::Registry::get_instance().GetGauge("records.spool.size");
+    metrics::Counter& spooled_ = metrics::Registry::get_instance().GetCounter("records.spooled");
+    metrics::Counter& replayed_ = metrics::Registry::get_instance().GetCounter("records.replayed");
+
+    // Потоки останавливаются первыми, до разрушения остальных полей
+    std::jthread guard_;
+    std::jthread worker_;
+};
+
+} // namespace db
+
+#endif //GAME_SERVER_RECORD_STORE_H
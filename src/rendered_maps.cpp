@@ -0,0 +1,90 @@
+#include <format>
+
+#include <boost/crc.hpp>
+#include <boost/json.hpp>
+
+#include "model.h"
+#include "model_json.h"
+#include "rendered_maps.h"
+
+namespace json = boost::json;
+
+namespace model {
+
+namespace {
+
+std::shared_ptr<const RenderedJson> Render(std::string body, const util::GzipOptions& gzip) {
+    boost::crc_32_type crc;
+    crc.process_bytes(body.data(), body.size());
+    // Сильный тег: совпадает только у побайтно одинаковых тел
+    auto etag = std::format(R"("{:x}-{:08x}")", body.size(), crc.checksum());
+    auto gzip_body = gzip.ShouldCompress(body.size()) ? util::GzipCompress(body, gzip.level) : std::string{};
+    return std::make_shared<const RenderedJson>(std::move(body), std::move(etag), std::move(gzip_body));
+}
+
+std::string_view Trim(std::string_view str) {
+    const auto first = str.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+} // namespace
+
+bool RenderedJson::MatchesETag(std::string_view if_none_match) const {
+    while (!if_none_match.empty()) {
+        const auto comma = if_none_match.find(',');
+        auto tag = Trim(if_none_match.substr(0, comma));
+        // If-None-Match сравнивает теги слабо
+        if (tag.starts_with("W/")) {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+RenderedMaps::RenderedMaps(std::shared_ptr<const MapTable> table, util::GzipOptions gzip)
+        : table_{std::move(table)}
+        , gzip_{gzip} {
+    json::array list;
+    list.reserve(table_->maps.size());
+    for (const auto& map : table_->maps) {
+        list.push_back(json::value_from(MapShortView{*map}));
+    }
+    list_ = Render(json::serialize(list), gzip_);
+}
+
+const std::shared_ptr<const MapTable>& RenderedMaps::GetTable() const {
+    return table_;
+}
+
+std::shared_ptr<const RenderedJson> RenderedMaps::GetList() const {
+    return list_;
+}
+
+std::shared_ptr<const RenderedJson> RenderedMaps::GetMap(const Map::Id& id) const {
+    {
+        std::lock_guard lock{mutex_};
+        if (auto it = maps_.find(id); it != maps_.end()) {
+            return it->second;
+        }
+    }
+    const auto map = table_->Find(id);
+    if (!map) {
+        return nullptr;
+    }
+    // Рендер вне блокировки; при гонке побеждает первый, тела всё равно одинаковы
+    auto rendered = Render(json::serialize(json::value_from(std::make_pair(*map, table_->loot_data.at(id)))), gzip_);
+    std::lock_guard lock{mutex_};
+    return maps_.try_emplace(id, std::move(rendered)).first->second;
+}
+
+}  // namespace model
@@ -0,0 +1,52 @@
+#ifndef GAME_SERVER_RENDERED_MAPS_H
+#define GAME_SERVER_RENDERED_MAPS_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "gzip.h"
+#include "model.h"
+
+namespace model {
+
+// Готовое тело ответа и его ETag
+struct RenderedJson {
+    std::string body;
+    std::string etag;
+    // Тело в gzip, сжатое один раз при рендере; пусто, если тело меньше порога
+    std::string gzip_body;
+
+    // Учитывает список тегов и "*" из If-None-Match
+    [[nodiscard]] bool MatchesETag(std::string_view if_none_match) const;
+};
+
+/*
+ * JSON карт одной версии таблицы. Список рендерится сразу, карта - при первом запросе.
+ * Таблица неизменяема, поэтому тела ответов тоже: их делят все запросы.
+ * Потокобезопасен; для новой таблицы создаётся новый объект.
+ */
+class RenderedMaps {
+public:
+    explicit RenderedMaps(std::shared_ptr<const MapTable> table, util::GzipOptions gzip = {});
+
+    [[nodiscard]] const std::shared_ptr<const MapTable>& GetTable() const;
+    [[nodiscard]] std::shared_ptr<const RenderedJson> GetList() const;
+    // nullptr, если карты нет в таблице
+    [[nodiscard]] std::shared_ptr<const RenderedJson> GetMap(const Map::Id& id) const;
+
+private:
+    using Rendered = std::unordered_map<Map::Id, std::shared_ptr<const RenderedJson>, util::TaggedHasher<Map::Id>>;
+
+    std::shared_ptr<const MapTable> table_;
+    util::GzipOptions gzip_;
+    std::shared_ptr<const RenderedJson> list_;
+    mutable std::mutex mutex_;
+    mutable Rendered maps_;
+};
+
+}  // namespace model
+
+#endif //GAME_SERVER_RENDERED_MAPS_H
@@ -1,7 +1,15 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
 #include <filesystem>
+#include <map>
 #include <optional>
 #include <string_view>
+#include <utility>
 
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
 #include <boost/json.hpp>
 #include <boost/system.hpp>
 #include <boost/beast.hpp>
@@ -9,6 +17,7 @@
 
 #include "request_handler.h"
 #include "handler_serializer.h"
+#include "metrics.h"
 
 namespace fs = std::filesystem;
 namespace beast = boost::beast;
@@ -18,6 +27,36 @@ namespace sys = boost::system;
 
 namespace http_handler {
 
+namespace {
+
+/*
+ * Разобранное тело запроса. Дерево размещается в арене поверх буфера на стеке
+ * обработчика, поэтому типичные тела разбираются без обращений к куче;
+ * крупные тела дозаказывают память у кучи. Строки читаются как string_view в арену.
+ */
+class RequestJson {
+public:
+    explicit RequestJson(std::string_view body)
+            : value_{json::parse(body, &arena_)} {
+    }
+
+    RequestJson(const RequestJson&) = delete;
+    RequestJson& operator=(const RequestJson&) = delete;
+
+    [[nodiscard]] const json::value& Get() const {
+        return value_;
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 4096;
+
+    alignas(std::max_align_t) unsigned char buffer_[BUFFER_SIZE];
+    json::monotonic_resource arena_{buffer_, BUFFER_SIZE};
+    json::value value_;
+};
+
+}  // namespace
+
 bool IsSubPath(fs::path path, fs::path base) {
     // Приводим оба пути к каноничному виду (без . и ..)
     path = fs::weakly_canonical(path);
@@ -85,6 +124,58 @@ StrResp APIHandler::BadResponse(const http::status& status, const ErrMsg& msg) {
     return PrepareHeader(std::move(resp));
 }
 
+StrResp APIHandler::RenderedResponse(const StrReqt &req, const model::RenderedJson& rendered) {
+    if (auto if_none_match = req.find(http::field::if_none_match);
+        if_none_match != req.end() && rendered.MatchesETag(if_none_match->value())) {
+        StrResp resp;
+        resp.result(http::status::not_modified);
+        resp.set(http::field::cache_control, "no-cache");
+        resp.set(http::field::etag, rendered.etag);
+        resp.keep_alive(true);
+        return resp;
+    }
+    const bool gzipped = !rendered.gzip_body.empty() && util::AcceptsGzip(req[http::field::accept_encoding]);
+    auto resp = GoodResponse(gzipped ? rendered.gzip_body : rendered.body);
+    if (!rendered.gzip_body.empty()) {
+        resp.set(http::field::vary, "Accept-Encoding");
+    }
+    if (gzipped) {
+        // Сжатое представление отличается побайтно, поэтому его тег слабый
+        resp.set(http::field::content_encoding, "gzip");
+        resp.set(http::field::etag, "W/" + rendered.etag);
+    } else {
+        resp.set(http::field::etag, rendered.etag);
+    }
+    return resp;
+}
+
+StrResp APIHandler::CompressResponse(StrResp &&resp, bool accepts_gzip, util::GzipCache* cache) const {
+    // Уже сжатые заранее тела не трогаем
+    if (resp.count(http::field::content_encoding) || !gzip_.ShouldCompress(resp.body().size())) {
+        return resp;
+    }
+    resp.set(http::field::vary, "Accept-Encoding");
+    if (!accepts_gzip) {
+        return resp;
+    }
+    resp.body() = cache ? *cache->Compress(resp.body()) : util::GzipCompress(resp.body(), gzip_.level);
+    resp.set(http::field::content_encoding, "gzip");
+    resp.prepare_payload();
+    return resp;
+}
+
+std::shared_ptr<const model::RenderedMaps> APIHandler::GetRenderedMaps() const {
+    auto table = app_.GetGame()->GetMapTable();
+    auto rendered = rendered_maps_.load();
+    if (rendered && rendered->GetTable() == table) {
+        return rendered;
+    }
+    // Таблицу подменили (или это первый запрос): прежние ответы больше не годятся
+    auto fresh = std::make_shared<const model::RenderedMaps>(std::move(table), gzip_);
+    rendered_maps_.store(fresh);
+    return fresh;
+}
+
 std::optional<std::string_view> APIHandler::TryExtractToken(const StrReqt &req) {
     auto auth_field = req.find(http::field::authorization);
     if (auth_field == req.end()) {
@@ -105,10 +196,8 @@ std::optional<std::string_view> APIHandler::TryExtractToken(const StrReqt &req)
     return token;
 }
 
-StrResp APIHandler::GetMapsListUseCase() const {
-    auto maps = app_.GetGame()->GetMaps();
-    std::vector<model::MapShortView> map_views{maps.begin(), maps.end()};
-    return GoodResponse(json::serialize(json::value_from(map_views)));
+StrResp APIHandler::GetMapsListUseCase(const StrReqt &req) const {
+    return RenderedResponse(req, *GetRenderedMaps()->GetList());
 }
 
 StrResp APIHandler::GetMapUseCase(StrReqt &&req) const {
@@ -120,14 +209,12 @@ StrResp APIHandler::GetMapUseCase(StrReqt &&req) const {
     }
 
     if (url == maps_url) {
-        return GetMapsListUseCase();
+        return GetMapsListUseCase(req);
     }
 
     const std::string map_id_str{url.substr(maps_url.length() + 1)};
-    auto map = app_.GetGame()->FindMap(model::Map::Id{map_id_str}); // TODO: does it worsen the arch?
-    if (map) {
-        auto loot = app_.GetGame()->GetLootData(map->GetId());
-        return GoodResponse(json::serialize(json::value_from(std::make_pair(*map, loot))));
+    if (auto rendered = GetRenderedMaps()->GetMap(model::Map::Id{map_id_str})) {
+        return RenderedResponse(req, *rendered);
     }
 
     return BadResponse(http::status::not_found, {"mapNotFound", "Map not found"});
@@ -143,25 +230,76 @@ static std::optional<int> GetUrlParam(const std::string& params, const std::stri
     return std::nullopt;
 }
 
-StrResp APIHandler::GetRecordsUseCase(http_handler::StrReqt &&req) const {
+static std::optional<std::string> GetUrlStringParam(const std::string& params, const std::string& name) {
+    boost::regex expr{"(\\?|&|^|,)"s + name + "=([\\w-]*)(\\&|$)"s };
+    boost::smatch what;
+    if (boost::regex_search(params, what, expr)) {
+        return what[2];
+    }
+    return std::nullopt;
+}
+
+static std::optional<uint64_t> GetUrlUnsignedParam(const std::string& params, const std::string& name) {
+    auto value = GetUrlStringParam(params, name);
+    uint64_t result = 0;
+    if (!value || std::from_chars(value->data(), value->data() + value->size(), result).ec != std::errc{}) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+void APIHandler::GetRecordsUseCase(http_handler::StrReqt &&req, Responder &&respond) const {
 
     if (req.method() != http::verb::get && req.method() != http::verb::head) {
-        return InvalidMethodResponse(http::verb::get, http::verb::head);
+        return respond(InvalidMethodResponse(http::verb::get, http::verb::head));
     }
 
     std::string url{req.target()};
 
-    auto req_start_param = GetUrlParam(url, "start");
-    auto req_count_param = GetUrlParam(url, "maxItems");
+    domain::RecordsQuery query;
+    query.start = GetUrlParam(url, "start");
+    query.max_items = GetUrlParam(url, "maxItems");
 
-    if (req_count_param.has_value()) {
-        if (req_count_param > 100) {
-            return BadResponse(http::status::bad_request, {"invalidArgument", "Too many items"});
+    if (query.max_items.has_value()) {
+        if (query.max_items > 100) {
+            return respond(BadResponse(http::status::bad_request, {"invalidArgument", "Too many items"}));
         }
     }
 
-    auto records = app_.GetRetiredDogs(req_start_param, req_count_param);
-    return GoodResponse(json::serialize(json::value_from(records)));
+    // after - курсор из заголовка X-Next-After предыдущей страницы, вместо смещения start
+    if (auto after = GetUrlStringParam(url, "after")) {
+        query.after = domain::DecodeCursor(*after);
+        if (!query.after || query.start) {
+            return respond(BadResponse(http::status::bad_request, {"invalidArgument", "Invalid records cursor"}));
+        }
+    }
+
+    // Курсор на следующую страницу известен, только если известно, откуда начиналась эта
+    const bool has_next_cursor = query.after || query.start.value_or(0) == 0;
+    app_.AsyncGetRetiredDogs(query, net::bind_executor(io_executor_,
+        [respond = std::move(respond), after = query.after, max_items = query.max_items, has_next_cursor](
+                std::exception_ptr error, domain::Retirees records) mutable {
+            if (error) {
+                return respond(BadResponse(http::status::internal_server_error, {"internalError", "Records are unavailable"}));
+            }
+            auto resp = GoodResponse(json::serialize(json::value_from(records)));
+            const bool full_page = max_items && records.size() == static_cast<size_t>(*max_items);
+            if (has_next_cursor && full_page) {
+                if (auto next = domain::NextCursor(records, after)) {
+                    resp.set("X-Next-After", domain::EncodeCursor(*next));
+                }
+            }
+            respond(std::move(resp));
+        }));
+}
+
+StrResp APIHandler::GetMetricsUseCase(StrReqt &&req) const {
+
+    if (req.method() != http::verb::get && req.method() != http::verb::head) {
+        return InvalidMethodResponse(http::verb::get, http::verb::head);
+    }
+
+    return GoodResponse(json::serialize(metrics::Registry::get_instance().ToJson()));
 }
 
 StrResp APIHandler::JoinGameUseCase(StrReqt &&req) {
@@ -171,20 +309,20 @@ StrResp APIHandler::JoinGameUseCase(StrReqt &&req) {
     }
 
     try {
-        const auto req_json = json::parse(req.body());
-        std::string username{req_json.at("userName").as_string()};
-        const std::string map_id_str{req_json.at("mapId").as_string()};
+        const RequestJson req_json{req.body()};
+        const std::string_view username = req_json.Get().at("userName").as_string();
+        const std::string_view map_id_str = req_json.Get().at("mapId").as_string();
 
         if (username.empty()) {
             return BadResponse(http::status::bad_request, {"invalidArgument", "Invalid name"});
         }
 
-        auto map = app_.GetGame()->FindMap(model::Map::Id{map_id_str});
+        auto map = app_.GetGame()->FindMap(model::Map::Id{std::string{map_id_str}});
         if (!map) {
             return BadResponse(http::status::not_found, {"mapNotFound", "Map not found"});
         }
 
-        const auto [player_id, auth_token] = app_.JoinGame(username, *map); // TODO: отвязать от модели
+        const auto [player_id, auth_token] = app_.JoinGame(std::string{username}, *map); // TODO: отвязать от модели
         return GoodResponse(json::serialize(json::value_from(JoinMsg{player_id, auth_token})));
 
     } catch (const std::exception& e) {
@@ -192,6 +330,58 @@ StrResp APIHandler::JoinGameUseCase(StrReqt &&req) {
     }
 }
 
+StrResp APIHandler::JoinGameBatchUseCase(StrReqt &&req) {
+    constexpr size_t MAX_BATCH_JOINS = 10'000;
+
+    if (req.method() != http::verb::post) {
+        return InvalidMethodResponse(http::verb::post);
+    }
+
+    std::vector<app::JoinRequest> joins;
+    // Держат карты, на которые ссылаются joins, даже если таблицу карт подменят
+    std::vector<std::shared_ptr<const model::Map>> used_maps;
+    try {
+        const RequestJson req_json{req.body()};
+        // Карта ищется один раз на каждый mapId из пачки
+        std::unordered_map<std::string_view, const model::Map*> maps;
+        const auto& joins_json = req_json.Get().as_array();
+        if (joins_json.size() > MAX_BATCH_JOINS) {
+            return BadResponse(http::status::bad_request, {"invalidArgument", "Too many items"});
+        }
+
+        joins.reserve(joins_json.size());
+        for (const auto& join_json : joins_json) {
+            const std::string_view username = join_json.at("userName").as_string();
+            const std::string_view map_id_str = join_json.at("mapId").as_string();
+
+            if (username.empty()) {
+                return BadResponse(http::status::bad_request, {"invalidArgument", "Invalid name"});
+            }
+
+            auto [it, inserted] = maps.try_emplace(map_id_str, nullptr);
+            if (inserted) {
+                if (auto map = app_.GetGame()->FindMap(model::Map::Id{std::string{map_id_str}})) {
+                    it->second = map.get();
+                    used_maps.push_back(std::move(map));
+                }
+            }
+            if (!it->second) {
+                return BadResponse(http::status::not_found, {"mapNotFound", "Map not found"});
+            }
+            joins.push_back({std::string{username}, it->second});
+        }
+    } catch (const std::exception& e) {
+        return BadResponse(http::status::bad_request, {"invalidArgument", "Join game request parse error"});
+    }
+
+    std::vector<JoinMsg> join_msgs;
+    join_msgs.reserve(joins.size());
+    for (auto& [player_id, auth_token] : app_.JoinGameBatch(joins)) {
+        join_msgs.push_back({player_id, std::move(auth_token)});
+    }
+    return GoodResponse(json::serialize(json::value_from(join_msgs)));
+}
+
 StrResp APIHandler::GetGameStateUseCase(StrReqt &&req) const {
 
     if (req.method() != http::verb::get && req.method() != http::verb::head) {
@@ -199,8 +389,11 @@ StrResp APIHandler::GetGameStateUseCase(StrReqt &&req) const {
     }
 
     if (auto token = TryExtractToken(req)) {
-        if (app_.GetPlayer(*token)) {
-            return GoodResponse(json::serialize(json::value_from(app_.GetGameState(*token))));
+        // Состояние пишется прямо в тело ответа
+        StrResp resp;
+        if (app_.WriteGameState(*token, resp.body())) {
+            resp.result(http::status::ok);
+            return PrepareHeader(std::move(resp));
         }
         return BadResponse(http::status::unauthorized, {"unknownToken", "Player token has not been found"});
     }
@@ -208,6 +401,114 @@ StrResp APIHandler::GetGameStateUseCase(StrReqt &&req) const {
     return BadResponse(http::status::unauthorized, {"invalidToken", "Authorization header has wrong format"});
 }
 
+void APIHandler::LongPollGameStateUseCase(StrReqt &&req, Responder &&respond) {
+
+    if (req.method() != http::verb::get && req.method() != http::verb::head) {
+        return respond(InvalidMethodResponse(http::verb::get, http::verb::head));
+    }
+
+    auto token = TryExtractToken(req);
+    if (!token) {
+        return respond(BadResponse(http::status::unauthorized, {"invalidToken", "Authorization header has wrong format"}));
+    }
+
+    const std::string url{req.target()};
+    const auto since = GetUrlUnsignedParam(url, "since");
+    if (!since) {
+        return respond(BadResponse(http::status::bad_request, {"invalidArgument", "Invalid state version"}));
+    }
+    const auto timeout = std::min(MAX_POLL_TIMEOUT,
+        GetUrlUnsignedParam(url, "timeout").transform([](uint64_t ms) {
+            return std::chrono::milliseconds(ms);
+        }).value_or(DEFAULT_POLL_TIMEOUT));
+
+    auto session = app_.GetPlayerSession(*token);
+    if (!session) {
+        return respond(BadResponse(http::status::unauthorized, {"unknownToken", "Player token has not been found"}));
+    }
+
+    const bool accepts_gzip = util::AcceptsGzip(req[http::field::accept_encoding]);
+    // Версия since закрыта тиком (или клиент её не знает) - изменения уже есть
+    if (*since != session->GetVersion() || timeout.count() == 0) {
+        return RespondStateWaiter({std::string{*token}, *since, accepts_gzip, std::move(respond), nullptr});
+    }
+
+    if (state_waiters_.size() >= MAX_STATE_WAITERS) {
+        // Ждущих слишком много: не копим их, клиент сразу придёт снова
+        return RespondStateWaiter({std::string{*token}, *since, accepts_gzip, std::move(respond), nullptr});
+    }
+
+    const auto id = next_waiter_id_++;
+    auto timer = std::make_shared<net::steady_timer>(strand_, timeout);
+    timer->async_wait([this, id](const sys::error_code& ec) {
+        if (!ec) {
+            OnStateWaitTimeout(id);
+        }
+    });
+    state_waiters_.emplace(id, StateWaiter{std::string{*token}, *since, accepts_gzip, std::move(respond), std::move(timer)});
+}
+
+StrResp APIHandler::StateChangesResponse(std::string_view token, uint64_t since) const {
+    StrResp resp;
+    if (!app_.WriteGameStateChanges(token, since, resp.body())) {
+        return BadResponse(http::status::unauthorized, {"unknownToken", "Player token has not been found"});
+    }
+    resp.result(http::status::ok);
+    return PrepareHeader(std::move(resp));
+}
+
+void APIHandler::WakeStateWaiters() {
+    auto waiters = std::exchange(state_waiters_, {});
+    // Без радиуса обзора изменения сессии с одной версии одинаковы для всех её игроков - пишем их один раз
+    std::map<std::pair<model::GameSession::Id::ValueType, uint64_t>, std::shared_ptr<const StrResp>> shared;
+    for (auto& [id, waiter] : waiters) {
+        waiter.timer->cancel();
+        auto session = app_.GetPlayerSession(waiter.token);
+        if (!session || session->GetMap()->GetViewRadius()) {
+            RespondStateWaiter(std::move(waiter));
+            continue;
+        }
+        auto& resp = shared[{session->GetIdValue(), waiter.since}];
+        if (!resp) {
+            resp = std::make_shared<const StrResp>(StateChangesResponse(waiter.token, waiter.since));
+        }
+        RespondOffStrand(resp, waiter.accepts_gzip, std::move(waiter.respond));
+    }
+}
+
+void APIHandler::OnStateWaitTimeout(uint64_t waiter_id) {
+    auto node = state_waiters_.extract(waiter_id);
+    // Пусто, если тик успел ответить раньше
+    if (!node.empty()) {
+        RespondStateWaiter(std::move(node.mapped()));
+    }
+}
+
+void APIHandler::RespondStateWaiter(StateWaiter &&waiter) {
+    RespondOffStrand(StateChangesResponse(waiter.token, waiter.since), waiter.accepts_gzip,
+                     IsSharedStateBody(waiter.token), std::move(waiter.respond));
+}
+
+bool APIHandler::IsSharedStateBody(std::string_view token) const {
+    auto session = app_.GetPlayerSession(token);
+    return session && !session->GetMap()->GetViewRadius();
+}
+
+void APIHandler::RespondOffStrand(StrResp &&resp, bool accepts_gzip, bool shared_body, Responder &&respond) {
+    net::post(io_executor_, [this, resp = std::move(resp), accepts_gzip, shared_body,
+                             respond = std::move(respond)]() mutable {
+        // Игроки одной сессии получают одно тело - оно сжимается один раз.
+        // Тела с радиусом обзора у каждого свои, кэш только вытеснял бы общие
+        respond(CompressResponse(std::move(resp), accepts_gzip, shared_body ? &state_gzip_ : nullptr));
+    });
+}
+
+void APIHandler::RespondOffStrand(std::shared_ptr<const StrResp> resp, bool accepts_gzip, Responder &&respond) {
+    net::post(io_executor_, [this, resp = std::move(resp), accepts_gzip, respond = std::move(respond)]() mutable {
+        respond(CompressResponse(StrResp{*resp}, accepts_gzip, &state_gzip_));
+    });
+}
+
 StrResp APIHandler::MovePlayerUseCase(StrReqt &&req) {
 
     if (req.method() != http::verb::post) {
@@ -215,28 +516,14 @@ StrResp APIHandler::MovePlayerUseCase(StrReqt &&req) {
     }
 
     if (auto token = TryExtractToken(req)) {
-        if (auto player_opt = app_.GetPlayer(*token)) {
+        if (app_.GetPlayer(*token)) {
             try {
-                auto req_json = json::parse(req.body());
-                auto dir_str = req_json.at("move").as_string().c_str();
-                auto player_ptr = player_opt.value();
-
-                const std::map<std::string, model::Direction> dir_map{
-                    {"U", model::Direction::NORTH},
-                    {"D", model::Direction::SOUTH},
-                    {"L", model::Direction::WEST},
-                    {"R", model::Direction::EAST},
-                    {"", model::Direction::NONE}
-                };
-
-                if (dir_map.find(dir_str) == dir_map.end()) {
+                const RequestJson req_json{req.body()};
+                auto direction = model::ParseDirection(req_json.Get().at("move").as_string());
+                if (!direction) {
                     throw std::runtime_error("Invalid direction");
                 }
-
-                // TODO: maybe refactor. PlayerID and DogID are the same(value) so far
-                auto sess_id = player_ptr->GetSessionId();
-                auto session = app_.GetGame()->GetSessions().at(*sess_id);
-                session->SetDogDirection(player_ptr->GetIdValue(), dir_map.at(dir_str));
+                app_.MovePlayer(*token, *direction);
                 return GoodResponse("{}");
 
             } catch (const std::exception& e) {
@@ -248,6 +535,46 @@ StrResp APIHandler::MovePlayerUseCase(StrReqt &&req) {
     return BadResponse(http::status::unauthorized, {"invalidToken", "Authorization header has wrong format"});
 }
 
+StrResp APIHandler::MovePlayersBatchUseCase(StrReqt &&req) {
+    constexpr size_t MAX_BATCH_ACTIONS = 100'000;
+
+    if (req.method() != http::verb::post) {
+        return InvalidMethodResponse(http::verb::post);
+    }
+
+    try {
+        const RequestJson req_json{req.body()};
+        const auto& actions_json = req_json.Get().as_array();
+        if (actions_json.size() > MAX_BATCH_ACTIONS) {
+            return BadResponse(http::status::bad_request, {"invalidArgument", "Too many items"});
+        }
+
+        // Сначала разбираем всю пачку, чтобы не применить её частично
+        std::vector<std::pair<std::string_view, model::Direction>> actions;
+        actions.reserve(actions_json.size());
+        for (const auto& action_json : actions_json) {
+            auto direction = model::ParseDirection(action_json.at("move").as_string());
+            if (!direction) {
+                throw std::runtime_error("Invalid direction");
+            }
+            actions.emplace_back(action_json.at("token").as_string(), *direction);
+        }
+
+        BatchActionsMsg result;
+        for (size_t i = 0; i < actions.size(); ++i) {
+            if (app_.MovePlayer(actions[i].first, actions[i].second)) {
+                ++result.applied;
+            } else {
+                result.rejected.push_back(i);
+            }
+        }
+        return GoodResponse(json::serialize(json::value_from(result)));
+
+    } catch (const std::exception& e) {
+        return BadResponse(http::status::bad_request, {"invalidArgument", "Action parse error"});
+    }
+}
+
 StrResp APIHandler::GameTickUseCase(StrReqt &&req) {
 
     if (req.method() != http::verb::post) {
@@ -255,8 +582,8 @@ StrResp APIHandler::GameTickUseCase(StrReqt &&req) {
     }
 
     try {
-        const auto req_json = json::parse(req.body());
-        const auto tick_ms = req_json.at("timeDelta").as_int64();
+        const RequestJson req_json{req.body()};
+        const auto tick_ms = req_json.Get().at("timeDelta").as_int64();
         app_.GetGame()->ExternalTick(std::chrono::milliseconds(tick_ms));
         return GoodResponse("{}");
 
@@ -281,7 +608,51 @@ StrResp APIHandler::GetPlayersListUseCase(StrReqt &&req) const {
     return BadResponse(http::status::unauthorized, {"invalidToken", "Authorization header is missing"});
 }
 
+bool APIHandler::IsStrandFree(std::string_view target) {
+    // Действия только кладут направление в ящик ввода собаки и ждут следующего тика
+    // Карты читаются из неизменяемой таблицы
+    return target == "/api/v1/game/player/action"
+           || target == "/api/v1/game/player/actions"
+           || target == "/api/v1/metrics"
+           || target.starts_with("/api/v1/maps");
+}
+
+bool APIHandler::IsAsync(std::string_view target) {
+    // Состояние пишется в strand'е, а сжимается вне его; long-poll ещё и ждёт тика
+    return target.starts_with("/api/v1/game/records")
+           || target == "/api/v1/game/state"
+           || target.starts_with("/api/v1/game/state?");
+}
+
+void APIHandler::AsyncResponse(StrReqt &&req, Responder &&respond) {
+    if (req.target().starts_with("/api/v1/game/records")) {
+        const bool accepts_gzip = util::AcceptsGzip(req[http::field::accept_encoding]);
+        return GetRecordsUseCase(std::move(req), [this, accepts_gzip, respond = std::move(respond)](StrResp&& resp) mutable {
+            respond(CompressResponse(std::move(resp), accepts_gzip));
+        });
+    }
+    if (req.target().starts_with("/api/v1/game/state?")) {
+        return net::dispatch(strand_, [this, req = std::move(req), respond = std::move(respond)]() mutable {
+            LongPollGameStateUseCase(std::move(req), std::move(respond));
+        });
+    }
+    if (req.target() == "/api/v1/game/state") {
+        return net::dispatch(strand_, [this, req = std::move(req), respond = std::move(respond)]() mutable {
+            const bool accepts_gzip = util::AcceptsGzip(req[http::field::accept_encoding]);
+            const auto token = TryExtractToken(req);
+            const bool shared_body = token && IsSharedStateBody(*token);
+            RespondOffStrand(GetGameStateUseCase(std::move(req)), accepts_gzip, shared_body, std::move(respond));
+        });
+    }
+    respond(Response(std::move(req)));
+}
+
 StrResp APIHandler::Response(StrReqt &&req) {
+    const bool accepts_gzip = util::AcceptsGzip(req[http::field::accept_encoding]);
+    return CompressResponse(Route(std::move(req)), accepts_gzip);
+}
+
+StrResp APIHandler::Route(StrReqt &&req) {
     auto url = req.target();
 
     // TODO: некрасиво, конечно...
@@ -293,6 +664,10 @@ StrResp APIHandler::Response(StrReqt &&req) {
         return MovePlayerUseCase(std::move(req));
     }
 
+    if (url == "/api/v1/game/player/actions") {
+        return MovePlayersBatchUseCase(std::move(req));
+    }
+
     if (url.starts_with("/api/v1/maps")) {
         return GetMapUseCase(std::move(req));
     }
@@ -301,6 +676,10 @@ StrResp APIHandler::Response(StrReqt &&req) {
         return JoinGameUseCase(std::move(req));
     }
 
+    if (url == "/api/v1/game/join/batch") {
+        return JoinGameBatchUseCase(std::move(req));
+    }
+
     if (url == "/api/v1/game/players") {
         return GetPlayersListUseCase(std::move(req));
     }
@@ -309,8 +688,8 @@ StrResp APIHandler::Response(StrReqt &&req) {
         return GameTickUseCase(std::move(req));
     }
 
-    if (url.starts_with("/api/v1/game/records")) {
-        return GetRecordsUseCase(std::move(req));
+    if (url == "/api/v1/metrics") {
+        return GetMetricsUseCase(std::move(req));
     }
 
     return BadResponse(http::status::bad_request, {"badRequest", "Bad request"});
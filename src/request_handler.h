@@ -1,19 +1,27 @@
 #ifndef REQUEST_HANDLER_H
 #define REQUEST_HANDLER_H
 
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <unordered_map>
 
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/json.hpp>
 #include <boost/system.hpp>
 
 #include "app.h"
+#include "gzip.h"
 #include "handler_serializer.h"
 #include "http_server.h"
 #include "model.h"
 #include "model_json.h"
+#include "rendered_maps.h"
 
 namespace http_handler {
 
@@ -51,26 +59,77 @@ struct ContentType {
 bool IsSubPath(fs::path path, fs::path base);
 ContentType::CON_TYPE GetContentType(const fs::path& file_path);
 
+using Responder = std::move_only_function<void(StrResp&&)>;
+
 class APIHandler {
 public:
-    explicit APIHandler(app::App& app) : app_{app} {}
+    explicit APIHandler(app::App& app, Strand strand, util::GzipOptions gzip = {})
+        : app_{app}
+        , strand_{std::move(strand)}
+        , io_executor_{strand_.get_inner_executor()}
+        , gzip_{gzip}
+        , state_gzip_{gzip.level} {
+    }
 public:
     StrResp Response(StrReqt &&req);
+    // Ответ на запрос, который завершается асинхронно (например, ждёт БД)
+    void AsyncResponse(StrReqt &&req, Responder &&respond);
+    // Запросы, которые можно обработать вне strand'а симуляции
+    [[nodiscard]] static bool IsStrandFree(std::string_view target);
+    [[nodiscard]] static bool IsAsync(std::string_view target);
+    // Отвечает запросам /game/state?since=, ждущим тика; вызывается в strand'е после тика
+    void WakeStateWaiters();
+
+    // Сверх этого запросы с since не ждут тика, а сразу получают изменения (обычно пустые)
+    static constexpr size_t MAX_STATE_WAITERS = 10'000;
+private:
+    // Запрос изменений, припаркованный до следующего тика или таймаута
+    struct StateWaiter {
+        std::string token;
+        uint64_t since;
+        bool accepts_gzip;
+        Responder respond;
+        std::shared_ptr<net::steady_timer> timer;
+    };
+
+    static constexpr std::chrono::milliseconds DEFAULT_POLL_TIMEOUT{10'000};
+    static constexpr std::chrono::milliseconds MAX_POLL_TIMEOUT{30'000};
 private:
     // TODO: мб можно сделать коллекцией endpoints
+    StrResp Route(StrReqt &&req);
     StrResp JoinGameUseCase(StrReqt &&req);
+    StrResp JoinGameBatchUseCase(StrReqt &&req);
     StrResp GetGameStateUseCase(StrReqt &&req) const;
+    // Выполняется в strand'е: отвечает сразу, если с версии since был тик, иначе паркует запрос
+    void LongPollGameStateUseCase(StrReqt &&req, Responder &&respond);
     StrResp MovePlayerUseCase(StrReqt &&req);
+    StrResp MovePlayersBatchUseCase(StrReqt &&req);
     StrResp GameTickUseCase(StrReqt &&req);
     StrResp GetPlayersListUseCase(StrReqt &&req) const;
-    StrResp GetMapsListUseCase() const;
+    StrResp GetMapsListUseCase(const StrReqt &req) const;
     StrResp GetMapUseCase(StrReqt &&req) const;
-    StrResp GetRecordsUseCase(StrReqt &&req) const;
+    StrResp GetMetricsUseCase(StrReqt &&req) const;
+    void GetRecordsUseCase(StrReqt &&req, Responder &&respond) const;
 private:
     static StrResp PrepareHeader(StrResp &&resp);
     static StrResp GoodResponse(std::string_view body);
     static StrResp BadResponse(const http::status& status, const ErrMsg& msg);
+    // 304, если у клиента уже есть это тело, иначе тело с ETag; сжатое тело берётся готовым
+    static StrResp RenderedResponse(const StrReqt &req, const model::RenderedJson& rendered);
+    // Сжимает тело не меньше порога, если клиент принимает gzip; с кэшем одинаковые тела сжимаются один раз
+    StrResp CompressResponse(StrResp &&resp, bool accepts_gzip, util::GzipCache* cache = nullptr) const;
+    // Ответы о картах текущей версии таблицы карт
+    [[nodiscard]] std::shared_ptr<const model::RenderedMaps> GetRenderedMaps() const;
     static std::optional<std::string_view> TryExtractToken(const StrReqt &req);
+    [[nodiscard]] StrResp StateChangesResponse(std::string_view token, uint64_t since) const;
+    void OnStateWaitTimeout(uint64_t waiter_id);
+    void RespondStateWaiter(StateWaiter &&waiter);
+    // Одинаково ли состояние для всех игроков сессии: без радиуса обзора сжатое тело можно делить
+    [[nodiscard]] bool IsSharedStateBody(std::string_view token) const;
+    // Тело уже записано в strand'е; сжатие и отправка - в потоках ввода-вывода.
+    // Общий ответ копируется для каждого получателя там же, вне strand'а
+    void RespondOffStrand(StrResp &&resp, bool accepts_gzip, bool shared_body, Responder &&respond);
+    void RespondOffStrand(std::shared_ptr<const StrResp> resp, bool accepts_gzip, Responder &&respond);
 public:
     // TODO: мб переделать на нешаблонную функцию с вектором
     template<typename First, typename... Args>
@@ -86,20 +145,35 @@ public:
     }
 private:
     app::App& app_;
+    Strand strand_;
+    net::io_context::executor_type io_executor_;
+    util::GzipOptions gzip_;
+    // Состояние сессии одно для всех её игроков
+    mutable util::GzipCache state_gzip_;
+    mutable std::atomic<std::shared_ptr<const model::RenderedMaps>> rendered_maps_;
+    // Только из strand'а
+    std::unordered_map<uint64_t, StateWaiter> state_waiters_;
+    uint64_t next_waiter_id_ = 0;
 };
 
 
 class RequestHandler {
 public:
-    explicit RequestHandler(Strand& api_strand, app::App& app, fs::path& static_content_path)
+    explicit RequestHandler(Strand& api_strand, app::App& app, fs::path& static_content_path,
+                            util::GzipOptions gzip = {})
         : api_strand_{api_strand}
-        , api_{app}
+        , api_{app, api_strand, gzip}
         , content_root_{static_content_path} {
     }
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
+    // Вызывается в strand'е после каждого тика
+    void OnTick() {
+        api_.WakeStateWaiters();
+    }
+
     template <typename Body, typename Allocator, typename Send>
     void operator()(http::request<Body, http::basic_fields<Allocator>> &&req, Send &&send) {
         if (req.target().starts_with("/api/"sv)) {
@@ -112,6 +186,14 @@ public:
 private:
     template <typename SendT>
     void HandleAPIRequest(StrReqt &&req, SendT &&send) {
+        if (APIHandler::IsAsync(req.target())) {
+            return api_.AsyncResponse(std::move(req), [send = std::forward<SendT>(send)](StrResp&& resp) mutable {
+                send(std::move(resp));
+            });
+        }
+        if (APIHandler::IsStrandFree(req.target())) {
+            return send(api_.Response(std::move(req)));
+        }
         net::dispatch(api_strand_, [this, req = std::move(req), send = std::forward<SendT>(send)]() mutable {
             send(api_.Response(std::move(req)));
         });
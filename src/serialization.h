@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "app.h"
 #include "geom.h"
@@ -51,12 +52,15 @@ void serialize(Archive& ar, Dog::Id& obj, [[maybe_unused]] const unsigned versio
 
 namespace serialization {
 
+class FlatSnapshot;
+
 // DogRepr (DogRepresentation) - сериализованное представление класса Dog
 class DogRepr {
 public:
     DogRepr() = default;
 
-    explicit DogRepr(const model::Dog& dog)
+    // Бездействие хранится длительностью: часы сессии при восстановлении могут быть другими
+    explicit DogRepr(const model::Dog& dog, std::chrono::milliseconds now = std::chrono::milliseconds{0})
         : id_(dog.GetIdValue())
         , name_(dog.GetName())
         , pos_(dog.GetPosition())
@@ -64,14 +68,18 @@ public:
         , speed_(dog.GetSpeed())
         , direction_(dog.GetDirection())
         , score_(dog.GetScore())
-        , bag_content_(dog.GetBagContent()) {
+        , bag_content_(dog.GetBagContent())
+        , play_time_ms_(dog.GetPlayTime().count())
+        , nonactive_time_ms_((now - dog.GetLastActive()).count()) {
     }
 
-    [[nodiscard]] model::Dog Restore() const {
+    [[nodiscard]] model::Dog Restore(std::chrono::milliseconds now = std::chrono::milliseconds{0}) const {
         model::Dog dog{id_, name_, pos_, bag_capacity_};
         dog.SetSpeed(speed_);
         dog.SetDirection(direction_);
         dog.AddScore(score_);
+        dog.AddPlayTime(std::chrono::milliseconds{play_time_ms_});
+        dog.SetLastActive(now - std::chrono::milliseconds{nonactive_time_ms_});
         for (const auto& item : bag_content_) {
             if (!dog.PutToBag(item)) {
                 throw std::runtime_error("Failed to put bag content");
@@ -81,7 +89,7 @@ public:
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& id_;
         ar& name_;
         ar& pos_;
@@ -90,9 +98,16 @@ public:
         ar& direction_;
         ar& score_;
         ar& bag_content_;
+        // В версии 0 время игры и бездействия не сохранялось и начинается заново
+        if (version > 0) {
+            ar& play_time_ms_;
+            ar& nonactive_time_ms_;
+        }
     }
 
 private:
+    friend class FlatSnapshot;
+
     model::Dog::Id::ValueType id_ = 0u;
     std::string name_;
     model::Point2D pos_;
@@ -101,6 +116,8 @@ private:
     model::Direction direction_ = model::Direction::NORTH;
     unsigned score_ = 0;
     std::vector<model::CargoItem> bag_content_;
+    int64_t play_time_ms_ = 0;
+    int64_t nonactive_time_ms_ = 0;
 };
 
 class GameSessionRepr {
@@ -108,46 +125,63 @@ public:
     GameSessionRepr() = default;
 
     explicit GameSessionRepr(const model::GameSession& game_session)
-            : map_id_val_(*game_session.GetMapId())
-            , id_val_(game_session.GetIdValue()) {
-        for (const auto& [id, loot] : game_session.GetLoots()) {
+            : GameSessionRepr(game_session.GetSnapshot()) {
+    }
+
+    explicit GameSessionRepr(const model::GameSession::Snapshot& snapshot)
+            : map_id_val_(*snapshot.map_id)
+            , id_val_(snapshot.id)
+            , now_ms_(snapshot.now.count()) {
+        loots_.reserve(snapshot.loots->size());
+        for (const auto& [id, loot] : *snapshot.loots) {
             loots_.emplace_back(loot);
         }
-        for (const auto& dog : game_session.GetDogs()) {
-            dogs_repr_.emplace_back(dog);
-        };
+        dogs_repr_.reserve(snapshot.dogs->size());
+        for (const auto& dog : *snapshot.dogs) {
+            dogs_repr_.emplace_back(dog, snapshot.now);
+        }
     }
 
     [[nodiscard]] std::shared_ptr<model::GameSession> Restore(std::shared_ptr<model::Game> game) const {
         model::Map::Id map_id{map_id_val_};
         auto game_session = std::make_shared<model::GameSession>(id_val_, game, map_id);
+        game_session->SetNow(std::chrono::milliseconds{now_ms_});
 
         std::map<uint64_t, model::LootItem> loots_to_set;
         for (const auto& loot : loots_) {
             loots_to_set[loot.id] = loot;
         }
-        game_session->SetLoots(loots_to_set);
+        game_session->SetLoots(std::move(loots_to_set));
 
+        std::vector<model::Dog> dogs;
+        dogs.reserve(dogs_repr_.size());
         for (const auto& dog : dogs_repr_) {
-            game_session->AddDog(dog.Restore());
+            dogs.push_back(dog.Restore(game_session->GetNow()));
         }
+        game_session->SetDogs(std::move(dogs));
 
         return game_session;
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& id_val_;
         ar& map_id_val_;
         ar& loots_;
         ar& dogs_repr_;
+        if (version > 0) {
+            ar& now_ms_;
+        }
     }
 
 private:
+    friend class FlatSnapshot;
+
     model::GameSession::Id::ValueType id_val_;
     model::Map::Id::ValueType map_id_val_;
     std::vector<model::LootItem> loots_;
     std::vector<DogRepr> dogs_repr_;
+    int64_t now_ms_ = 0;
 };
 
 class GameRepr {
@@ -159,6 +193,13 @@ public:
        }
     }
 
+    explicit GameRepr(const std::vector<model::GameSession::Snapshot>& sessions) {
+        sessions_.reserve(sessions.size());
+        for (const auto& session : sessions) {
+            sessions_.emplace_back(session);
+        }
+    }
+
     void Restore(std::shared_ptr<model::Game> game) const {
         for (const auto& sess : sessions_) {
             game->AddSession(sess.Restore(game));
@@ -171,6 +212,8 @@ public:
     }
 
 private:
+    friend class FlatSnapshot;
+
     std::vector<GameSessionRepr> sessions_;
 };
 
@@ -199,6 +242,8 @@ public:
         ar& token_;
     }
 private:
+    friend class FlatSnapshot;
+
     app::Player::Id::ValueType id_val_;
     model::GameSession::Id::ValueType sess_id_val_;
     std::string name_;
@@ -208,8 +253,13 @@ private:
 class AllPlayersRepr {
 public:
     AllPlayersRepr() = default;
-    explicit AllPlayersRepr(const app::Players& players) {
-        for (const auto& [id, player] : players.GetPlayers()) {
+    explicit AllPlayersRepr(const app::Players& players)
+        : AllPlayersRepr(*players.GetSnapshot()) {
+    }
+
+    explicit AllPlayersRepr(const app::Players::PlayerMap& players) {
+        players_.reserve(players.size());
+        for (const auto& [id, player] : players) {
             players_.emplace_back(*player);
         }
     }
@@ -227,33 +277,174 @@ public:
         ar& players_;
     }
 private:
+    friend class FlatSnapshot;
+
     std::vector<PlayerRepr> players_;
 };
 
+// Изменения сессии за тик: изменённые собаки и трофеи целиком, удалённые - по id
+class SessionDeltaRepr {
+public:
+    SessionDeltaRepr() = default;
+    SessionDeltaRepr(const model::GameSession& session, const model::GameSession::Changes& changes)
+            : id_val_(session.GetIdValue())
+            , map_id_val_(*session.GetMapId())
+            , now_ms_(session.GetNow().count())
+            , removed_dogs_(changes.removed_dogs)
+            , loots_(changes.loots)
+            , removed_loots_(changes.removed_loots) {
+        dogs_repr_.reserve(changes.dogs.size());
+        for (const auto& dog : changes.dogs) {
+            dogs_repr_.emplace_back(dog, session.GetNow());
+        }
+    }
+
+    void Apply(const std::shared_ptr<model::Game>& game) const {
+        auto session = game->FindSession(model::GameSession::Id{id_val_});
+        if (!session) {
+            session = std::make_shared<model::GameSession>(id_val_, game, model::Map::Id{map_id_val_});
+            game->AddSession(session);
+        }
+        session->SetNow(std::chrono::milliseconds{now_ms_});
+        // Сначала удаления: id собаки мог освободиться и достаться новой
+        for (auto id : removed_dogs_) {
+            session->RemoveDog(id);
+        }
+        for (auto id : removed_loots_) {
+            session->RemoveLoot(id);
+        }
+        for (const auto& dog : dogs_repr_) {
+            session->UpsertDog(dog.Restore(session->GetNow()));
+        }
+        for (const auto& loot : loots_) {
+            session->UpsertLoot(loot);
+        }
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, const unsigned version) {
+        ar& id_val_;
+        ar& map_id_val_;
+        ar& dogs_repr_;
+        ar& removed_dogs_;
+        ar& loots_;
+        ar& removed_loots_;
+        if (version > 0) {
+            ar& now_ms_;
+        }
+    }
+
+private:
+    model::GameSession::Id::ValueType id_val_ = 0;
+    model::Map::Id::ValueType map_id_val_;
+    int64_t now_ms_ = 0;
+    std::vector<DogRepr> dogs_repr_;
+    std::vector<model::Dog::Id::ValueType> removed_dogs_;
+    std::vector<model::LootItem> loots_;
+    std::vector<uint64_t> removed_loots_;
+};
+
+// Запись журнала: всё, что изменилось за тик
+class TickDeltaRepr {
+public:
+    TickDeltaRepr() = default;
+    TickDeltaRepr(std::vector<SessionDeltaRepr> sessions, const app::PlayerChanges& players)
+            : sessions_(std::move(sessions))
+            , left_players_(players.left) {
+        joined_players_.reserve(players.joined.size());
+        for (const auto& player : players.joined) {
+            joined_players_.emplace_back(*player);
+        }
+    }
+
+    [[nodiscard]] bool IsEmpty() const {
+        return sessions_.empty() && joined_players_.empty() && left_players_.empty();
+    }
+
+    void Apply(app::App& app) const {
+        for (const auto& session : sessions_) {
+            session.Apply(app.GetGame());
+        }
+        app::PlayerChanges players;
+        players.left = left_players_;
+        for (const auto& player : joined_players_) {
+            players.joined.push_back(std::make_shared<app::Player>(player.Restore()));
+        }
+        app.ApplyPlayerChanges(players);
+    }
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& sessions_;
+        ar& joined_players_;
+        ar& left_players_;
+    }
+
+private:
+    std::vector<SessionDeltaRepr> sessions_;
+    std::vector<PlayerRepr> joined_players_;
+    std::vector<app::Player::Id::ValueType> left_players_;
+};
+
 class AppRepr {
 public:
     AppRepr() = default;
-    explicit AppRepr(app::App& app)
-        : game_(app.GetGame())
-        , players_(app.GetPlayers()) {
+    explicit AppRepr(app::App& app, uint64_t journal_segment = 0)
+        : AppRepr(app.GetGame(), app.GetPlayers(), journal_segment) {
+    }
+    AppRepr(const std::shared_ptr<model::Game>& game, const app::Players& players, uint64_t journal_segment = 0)
+        : game_(game)
+        , players_(players)
+        , journal_segment_(journal_segment)
+        , next_session_id_(game->GetNextSessionId()) {
+    }
+    // Из снимков сессий и игроков, можно строить вне потока симуляции
+    AppRepr(const std::vector<model::GameSession::Snapshot>& sessions, const app::Players::PlayerMap& players,
+            uint64_t journal_segment, model::GameSession::Id::ValueType next_session_id)
+        : game_(sessions)
+        , players_(players)
+        , journal_segment_(journal_segment)
+        , next_session_id_(next_session_id) {
     }
 
     void Restore(app::App& app) const {
         auto game_ptr = app.GetGame();
         game_.Restore(game_ptr);
+        game_ptr->SetNextSessionId(next_session_id_);
         app.RestorePlayers(players_.Restore());
     }
 
+    // Первый сегмент журнала, который нужно применить поверх этого снимка
+    [[nodiscard]] uint64_t GetJournalSegment() const {
+        return journal_segment_;
+    }
+
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& game_;
         ar& players_;
+        if (version > 0) {
+            ar& journal_segment_;
+        }
+        // В версиях до 2 следующий id берётся по восстановленным сессиям
+        if (version > 1) {
+            ar& next_session_id_;
+        }
     }
 private:
+    friend class FlatSnapshot;
+
     GameRepr game_;
     AllPlayersRepr players_;
+    uint64_t journal_segment_ = 0;
+    model::GameSession::Id::ValueType next_session_id_ = 0;
 };
 
 }  // namespace serialization
 
+BOOST_CLASS_VERSION(::serialization::DogRepr, 1)
+BOOST_CLASS_VERSION(::serialization::GameSessionRepr, 1)
+BOOST_CLASS_VERSION(::serialization::SessionDeltaRepr, 1)
+BOOST_CLASS_VERSION(::serialization::AppRepr, 2)
+
 #endif  // SERIALIZATION_H
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "spatial_grid.h"
+
+namespace model {
+
+namespace {
+
+// Не больше стольких ячеек на точку: пустая сетка не должна занимать память
+constexpr size_t CELLS_PER_ENTRY = 4;
+constexpr size_t MIN_CELLS = 1024;
+
+} // namespace
+
+void SpatialGrid::Build(const std::vector<Entry>& entries, double cell_size) {
+    Clear();
+    if (entries.empty()) {
+        return;
+    }
+
+    double max_x = entries.front().pos.x;
+    double max_y = entries.front().pos.y;
+    min_x_ = max_x;
+    min_y_ = max_y;
+    for (const auto& entry : entries) {
+        min_x_ = std::min(min_x_, entry.pos.x);
+        min_y_ = std::min(min_y_, entry.pos.y);
+        max_x = std::max(max_x, entry.pos.x);
+        max_y = std::max(max_y, entry.pos.y);
+    }
+
+    // На разреженной большой карте ячейки укрупняются: запрос остаётся точным, просто проверяет больше точек
+    const size_t max_cells = std::max(MIN_CELLS, entries.size() * CELLS_PER_ENTRY);
+    cell_size_ = cell_size > 0.0 ? cell_size : 1.0;
+    while (true) {
+        columns_ = static_cast<size_t>((max_x - min_x_) / cell_size_) + 1;
+        rows_ = static_cast<size_t>((max_y - min_y_) / cell_size_) + 1;
+        if (columns_ * rows_ <= max_cells) {
+            break;
+        }
+        cell_size_ *= 2;
+    }
+
+    // Подсчёт: сначала размеры ячеек, затем раскладка с конца каждой ячейки
+    const size_t cell_count = columns_ * rows_;
+    cell_starts_.assign(cell_count + 1, 0);
+    entry_cells_.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const auto [column, row] = CellOf(entries[i].pos);
+        entry_cells_[i] = static_cast<uint32_t>(row * columns_ + column);
+        ++cell_starts_[entry_cells_[i]];
+    }
+    for (size_t cell = 1; cell < cell_count; ++cell) {
+        cell_starts_[cell] += cell_starts_[cell - 1];
+    }
+    cell_starts_[cell_count] = static_cast<uint32_t>(entries.size());
+    entries_.resize(entries.size());
+    for (size_t i = entries.size(); i-- > 0;) {
+        entries_[--cell_starts_[entry_cells_[i]]] = entries[i];
+    }
+}
+
+void SpatialGrid::Clear() {
+    columns_ = 0;
+    rows_ = 0;
+    cell_starts_.clear();
+    entries_.clear();
+}
+
+} // namespace model
@@ -0,0 +1,86 @@
+#ifndef GAME_SERVER_SPATIAL_GRID_H
+#define GAME_SERVER_SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "geom.h"
+
+namespace model {
+
+/*
+ * Равномерная сетка точек для поиска соседей в радиусе.
+ * Точки разложены по ячейкам подсчётом, без хеш-таблиц: ячейка - непрерывный отрезок массива.
+ * Строится заново на каждом тике, буферы переиспользуются между постройками.
+ */
+class SpatialGrid {
+public:
+    struct Entry {
+        Point2D pos;
+        uint64_t id;
+    };
+
+    // Ячейка размером с радиус обзора: запрос затрагивает не больше 3x3 ячеек
+    void Build(const std::vector<Entry>& entries, double cell_size);
+    void Clear();
+
+    [[nodiscard]] size_t Size() const {
+        return entries_.size();
+    }
+
+    // Вызывает fn(id) для точек не дальше radius от center; при отрицательном или NaN радиусе - ни для каких
+    template <typename Fn>
+    void ForEachInRadius(Point2D center, double radius, Fn&& fn) const {
+        if (entries_.empty() || !(radius >= 0.0)) {
+            return;
+        }
+        const auto [first_column, first_row] = CellOf({center.x - radius, center.y - radius});
+        const auto [last_column, last_row] = CellOf({center.x + radius, center.y + radius});
+        const double radius_sq = radius * radius;
+        for (size_t row = first_row; row <= last_row; ++row) {
+            const size_t row_start = row * columns_;
+            // Ячейки строки подряд - один непрерывный отрезок
+            const auto begin = entries_.begin() + cell_starts_[row_start + first_column];
+            const auto end = entries_.begin() + cell_starts_[row_start + last_column + 1];
+            for (auto it = begin; it != end; ++it) {
+                const double dx = it->pos.x - center.x;
+                const double dy = it->pos.y - center.y;
+                if (dx * dx + dy * dy <= radius_sq) {
+                    fn(it->id);
+                }
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        size_t column;
+        size_t row;
+    };
+
+    // Точки вне сетки прижимаются к крайним ячейкам
+    [[nodiscard]] Cell CellOf(Point2D pos) const {
+        return {Clamp((pos.x - min_x_) / cell_size_, columns_), Clamp((pos.y - min_y_) / cell_size_, rows_)};
+    }
+
+    static size_t Clamp(double cell, size_t count) {
+        if (!(cell > 0.0)) {
+            return 0;
+        }
+        return static_cast<size_t>(std::min(cell, static_cast<double>(count - 1)));
+    }
+
+    double cell_size_ = 1.0;
+    double min_x_ = 0.0;
+    double min_y_ = 0.0;
+    size_t columns_ = 0;
+    size_t rows_ = 0;
+    std::vector<uint32_t> cell_starts_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> entry_cells_;
+};
+
+} // namespace model
+
+#endif //GAME_SERVER_SPATIAL_GRID_H
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "state_writer.h"
+
+namespace model {
+
+namespace {
+
+// Максимальная длина uint64 в десятичной записи
+constexpr size_t MAX_DIGITS = 20;
+// Примерный размер записи собаки и трофея без содержимого рюкзака
+constexpr size_t DOG_SIZE_HINT = 128;
+constexpr size_t CARGO_SIZE_HINT = 24;
+constexpr size_t LOOT_SIZE_HINT = 48;
+
+void AppendUnsigned(std::string& out, uint64_t value) {
+    std::array<char, MAX_DIGITS> buf{};
+    const auto [end, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value);
+    out.append(buf.data(), end);
+}
+
+void AppendPoint(std::string& out, double x, double y) {
+    out += '[';
+    AppendJsonDouble(out, x);
+    out += ',';
+    AppendJsonDouble(out, y);
+    out += ']';
+}
+
+std::string_view DirectionLiteral(Direction direction) {
+    switch (direction) {
+        case Direction::NORTH:
+            return R"("U")";
+        case Direction::SOUTH:
+            return R"("D")";
+        case Direction::WEST:
+            return R"("L")";
+        case Direction::EAST:
+            return R"("R")";
+        case Direction::NONE:
+            return R"("")";
+    }
+    throw std::runtime_error("Unknown direction");
+}
+
+// Ключ объекта: id в десятичной записи и запись, к которой он относится
+template <typename T>
+struct DecimalKey {
+    std::array<char, MAX_DIGITS> digits;
+    uint8_t size;
+    const T* item;
+
+    [[nodiscard]] std::string_view View() const {
+        return {digits.data(), size};
+    }
+};
+
+/*
+ * Раньше ключи были std::map<std::string, T>, поэтому порядок строковый: "10" < "2".
+ * Буфер ключей свой у каждого потока и переиспользуется между запросами.
+ */
+template <typename T>
+const T& DerefItem(const T& item) {
+    return item;
+}
+
+// Отобранные по радиусу обзора записи передаются указателями
+template <typename T>
+const T& DerefItem(const T* item) {
+    return *item;
+}
+
+template <typename T, typename Range, typename GetId>
+const std::vector<DecimalKey<T>>& SortedKeys(const Range& items, GetId get_id) {
+    thread_local std::vector<DecimalKey<T>> keys;
+    keys.clear();
+    keys.reserve(std::size(items));
+    for (const auto& element : items) {
+        const T& item = DerefItem<T>(element);
+        auto& key = keys.emplace_back();
+        const auto [end, ec] = std::to_chars(key.digits.data(), key.digits.data() + key.digits.size(), get_id(item));
+        key.size = static_cast<uint8_t>(end - key.digits.data());
+        key.item = &item;
+    }
+    std::sort(keys.begin(), keys.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.View() < rhs.View();
+    });
+    return keys;
+}
+
+void AppendDog(std::string& out, const Dog& dog) {
+    const auto position = dog.GetPosition();
+    const auto speed = dog.GetSpeed();
+    out += R"({"pos":)";
+    AppendPoint(out, position.x, position.y);
+    out += R"(,"speed":)";
+    AppendPoint(out, speed.dx, speed.dy);
+    out += R"(,"dir":)";
+    out += DirectionLiteral(dog.GetDirection());
+    out += R"(,"bag":[)";
+    bool first = true;
+    for (const auto& cargo : dog.GetBagContent()) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        out += R"({"id":)";
+        AppendUnsigned(out, cargo.id);
+        out += R"(,"type":)";
+        AppendUnsigned(out, cargo.type);
+        out += '}';
+    }
+    out += R"(],"score":)";
+    AppendUnsigned(out, dog.GetScore());
+    out += '}';
+}
+
+void AppendLoot(std::string& out, const LootItem& loot) {
+    out += R"({"type":)";
+    AppendUnsigned(out, loot.type);
+    out += R"(,"pos":)";
+    AppendPoint(out, loot.pos.x, loot.pos.y);
+    out += '}';
+}
+
+template <typename Range>
+size_t SizeHint(const Range& dogs, size_t loot_count) {
+    size_t size_hint = 64 + std::size(dogs) * DOG_SIZE_HINT + loot_count * LOOT_SIZE_HINT;
+    for (const auto& dog : dogs) {
+        size_hint += DerefItem<Dog>(dog).GetBagContent().size() * CARGO_SIZE_HINT;
+    }
+    return size_hint;
+}
+
+// Объект вида {"id":{...},...}
+template <typename T, typename Range, typename GetId, typename AppendItem>
+void AppendObject(std::string& out, const Range& items, GetId get_id, AppendItem append_item) {
+    out += '{';
+    bool first = true;
+    for (const auto& key : SortedKeys<T>(items, get_id)) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        out += '"';
+        out += key.View();
+        out += R"(":)";
+        append_item(out, *key.item);
+    }
+    out += '}';
+}
+
+template <typename Range>
+void AppendDogs(std::string& out, const Range& dogs) {
+    AppendObject<Dog>(out, dogs, [](const Dog& dog) { return dog.GetIdValue(); }, AppendDog);
+}
+
+template <typename T, typename Range, typename GetLoot>
+void AppendLoots(std::string& out, const Range& loots, GetLoot get_loot) {
+    AppendObject<T>(out, loots, [&get_loot](const T& entry) { return get_loot(entry).id; },
+                    [&get_loot](std::string& dest, const T& entry) { AppendLoot(dest, get_loot(entry)); });
+}
+
+void AppendIds(std::string& out, const std::vector<uint64_t>& ids) {
+    out += '[';
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i != 0) {
+            out += ',';
+        }
+        AppendUnsigned(out, ids[i]);
+    }
+    out += ']';
+}
+
+} // namespace
+
+void AppendJsonDouble(std::string& out, double value) {
+    if (std::isnan(value)) {
+        out += "NaN";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value < 0 ? "-Infinity" : "Infinity";
+        return;
+    }
+    // to_chars даёт кратчайшую точную запись "1.25e+01", Boost.JSON пишет её как "1.25E1"
+    std::array<char, 32> buf{};
+    const auto [end, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value, std::chars_format::scientific);
+    const std::string_view chars{buf.data(), static_cast<size_t>(end - buf.data())};
+    const auto e = chars.find('e');
+    out.append(chars.substr(0, e));
+    out += 'E';
+    auto exponent = chars.substr(e + 1);
+    if (exponent.front() == '-') {
+        out += '-';
+    }
+    exponent.remove_prefix(1);
+    const auto significant = exponent.find_first_not_of('0');
+    out.append(significant == std::string_view::npos ? std::string_view{"0"} : exponent.substr(significant));
+}
+
+void WriteGameState(const GameSession& session, std::string& out) {
+    const auto& dogs = session.GetDogs();
+    const auto& loots = session.GetLoots();
+    out.reserve(out.size() + SizeHint(dogs, loots.size()));
+
+    out += R"({"players":)";
+    AppendDogs(out, dogs);
+    out += R"(,"lostObjects":)";
+    using LootEntry = std::pair<const uint64_t, LootItem>;
+    AppendLoots<LootEntry>(out, loots, [](const LootEntry& loot) -> const LootItem& { return loot.second; });
+    out += '}';
+}
+
+void WriteGameState(const GameSession& session, Dog::Id::ValueType viewer, std::string& out) {
+    const auto view_radius = session.GetMap()->GetViewRadius();
+    const auto* grids = session.GetInterestGrids();
+    const auto* viewer_dog = session.GetDog(viewer);
+    if (!view_radius || !grids || !viewer_dog) {
+        return WriteGameState(session, out);
+    }
+
+    // Своя собака видна всегда, даже если вошла в игру после тика
+    thread_local std::vector<const Dog*> dogs;
+    thread_local std::vector<const LootItem*> loots;
+    dogs.assign(1, viewer_dog);
+    loots.clear();
+    const auto center = viewer_dog->GetPosition();
+    grids->dogs.ForEachInRadius(center, *view_radius, [&session, viewer](uint64_t id) {
+        // Собаки, ушедшие из сессии после тика, пропускаются
+        if (const auto* dog = session.GetDog(id); dog && id != viewer) {
+            dogs.push_back(dog);
+        }
+    });
+    const auto& all_loots = session.GetLoots();
+    grids->loots.ForEachInRadius(center, *view_radius, [&all_loots](uint64_t id) {
+        if (auto it = all_loots.find(id); it != all_loots.end()) {
+            loots.push_back(&it->second);
+        }
+    });
+    out.reserve(out.size() + SizeHint(dogs, loots.size()));
+
+    out += R"({"players":)";
+    AppendDogs(out, dogs);
+    out += R"(,"lostObjects":)";
+    AppendLoots<LootItem>(out, loots, [](const LootItem& loot) -> const LootItem& { return loot; });
+    out += '}';
+}
+
+void WriteGameStateChanges(const GameSession& session, Dog::Id::ValueType viewer, uint64_t since, std::string& out) {
+    const auto version = session.GetVersion();
+    // С радиусом обзора изменения не фильтруются: по ним не понять, что игрок видел на версии since
+    // и что ушло из обзора. Такие карты всегда получают отфильтрованное полное состояние
+    const bool has_view_radius = session.GetMap()->GetViewRadius().has_value();
+    const auto changes = has_view_radius || since == 0 || since > version ? std::nullopt
+                                                                          : session.GetChangesSince(since);
+    if (!changes) {
+        WriteGameState(session, viewer, out);
+        out.pop_back();
+        out += R"(,"version":)";
+        AppendUnsigned(out, version);
+        out += R"(,"full":true})";
+        return;
+    }
+
+    out.reserve(out.size() + SizeHint(changes->dogs, changes->loots.size())
+                + (changes->removed_dogs.size() + changes->removed_loots.size()) * (MAX_DIGITS + 1));
+    out += R"({"players":)";
+    AppendDogs(out, changes->dogs);
+    out += R"(,"lostObjects":)";
+    AppendLoots<LootItem>(out, changes->loots, [](const LootItem& loot) -> const LootItem& { return loot; });
+    out += R"(,"removedPlayers":)";
+    AppendIds(out, changes->removed_dogs);
+    out += R"(,"removedObjects":)";
+    AppendIds(out, changes->removed_loots);
+    out += R"(,"version":)";
+    AppendUnsigned(out, version);
+    out += R"(,"full":false})";
+}
+
+}  // namespace model
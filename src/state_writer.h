@@ -0,0 +1,38 @@
+#ifndef GAME_SERVER_STATE_WRITER_H
+#define GAME_SERVER_STATE_WRITER_H
+
+#include <string>
+
+#include "model.h"
+
+namespace model {
+
+/*
+ * Пишет состояние сессии для /api/v1/game/state прямо в строку, без дерева json::value.
+ * Вывод побайтно совпадает с json::serialize(json::value_from(GameState)):
+ * ключи - id в десятичной записи в строковом порядке, числа с плавающей точкой -
+ * кратчайшая точная запись в виде 1.25E1, как у Boost.JSON.
+ */
+void WriteGameState(const GameSession& session, std::string& out);
+
+/*
+ * Состояние, которое видит игрок viewer: его собака и то, что на последнем тике было
+ * в радиусе обзора карты. Без радиуса, до первого тика или без собаки - всё состояние.
+ */
+void WriteGameState(const GameSession& session, Dog::Id::ValueType viewer, std::string& out);
+
+/*
+ * Изменения сессии с версии since для long-poll:
+ * {"players":{...},"lostObjects":{...},"removedPlayers":[...],"removedObjects":[...],"version":V,"full":false}.
+ * Полное состояние с "full":true, если since == 0, since больше текущей версии
+ * или удаления с since уже забыты. На картах с радиусом обзора всегда полное состояние,
+ * ограниченное им, как у WriteGameState для viewer. Клиент передаёт V в следующем запросе.
+ */
+void WriteGameStateChanges(const GameSession& session, Dog::Id::ValueType viewer, uint64_t since, std::string& out);
+
+// Число в формате Boost.JSON
+void AppendJsonDouble(std::string& out, double value);
+
+}  // namespace model
+
+#endif //GAME_SERVER_STATE_WRITER_H
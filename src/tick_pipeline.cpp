@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <latch>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/asio/post.hpp>
+
+#include "logger.h"
+#include "tick_pipeline.h"
+
+namespace model {
+
+namespace net = boost::asio;
+using Clock = std::chrono::steady_clock;
+
+/*
+ * TickPipeline methods
+ */
+TickPipeline::TickPipeline(size_t threads)
+        : threads_{threads} {
+}
+
+TickPipeline::~TickPipeline() {
+    Stop();
+}
+
+void TickPipeline::AddStage(std::string name, Stage stage, Mode mode, std::vector<std::string> after) {
+    if (std::any_of(stages_.begin(), stages_.end(), [&name](const auto& info) { return info->name == name; })) {
+        throw std::invalid_argument("Tick stage " + name + " already exists");
+    }
+    auto info = std::make_unique<StageInfo>();
+    info->duration_ms = &metrics::Registry::get_instance().GetHistogram("tick.stage." + name + "_ms");
+    info->name = std::move(name);
+    info->stage = std::move(stage);
+    info->mode = mode;
+    info->after = std::move(after);
+    if (mode != Mode::INLINE && !pool_ && !stopped_) {
+        pool_.emplace(threads_);
+    }
+    stages_.push_back(std::move(info));
+    planned_ = false;
+}
+
+void TickPipeline::Plan() {
+    std::unordered_map<std::string, StageInfo*> by_name;
+    for (const auto& info : stages_) {
+        by_name.emplace(info->name, info.get());
+    }
+    for (const auto& info : stages_) {
+        for (const auto& dependency : info->after) {
+            auto it = by_name.find(dependency);
+            if (it == by_name.end()) {
+                throw std::logic_error("Tick stage " + info->name + " depends on unknown stage " + dependency);
+            }
+            if (it->second->mode == Mode::BACKGROUND) {
+                // Фоновая стадия не заканчивается в пределах тика
+                throw std::logic_error("Tick stage " + info->name + " cannot wait for background stage " + dependency);
+            }
+        }
+    }
+
+    // Уровень стадии - длина самой длинной цепочки зависимостей до неё
+    std::unordered_map<const StageInfo*, size_t> levels;
+    std::unordered_map<const StageInfo*, bool> visiting;
+    std::function<size_t(StageInfo*)> level_of = [&](StageInfo* info) -> size_t {
+        if (auto it = levels.find(info); it != levels.end()) {
+            return it->second;
+        }
+        if (visiting[info]) {
+            throw std::logic_error("Tick stages have a dependency cycle through " + info->name);
+        }
+        visiting[info] = true;
+        size_t level = 0;
+        for (const auto& dependency : info->after) {
+            level = std::max(level, level_of(by_name.at(dependency)) + 1);
+        }
+        visiting[info] = false;
+        levels.emplace(info, level);
+        return level;
+    };
+
+    levels_.clear();
+    for (const auto& info : stages_) {
+        const size_t level = level_of(info.get());
+        if (levels_.size() <= level) {
+            levels_.resize(level + 1);
+        }
+        // Внутри уровня сохраняется порядок добавления
+        levels_[level].push_back(info.get());
+    }
+    planned_ = true;
+}
+
+void TickPipeline::Run(std::chrono::milliseconds delta) {
+    if (!planned_) {
+        Plan();
+    }
+    for (const auto& level : levels_) {
+        std::vector<StageInfo*> parallel;
+        for (auto* info : level) {
+            if (stopped_) {
+                Execute(*info, delta);
+                continue;
+            }
+            switch (info->mode) {
+                case Mode::INLINE:
+                    Execute(*info, delta);
+                    break;
+                case Mode::PARALLEL:
+                    parallel.push_back(info);
+                    break;
+                case Mode::BACKGROUND:
+                    RunBackground(*info, delta);
+                    break;
+            }
+        }
+        if (parallel.empty()) {
+            continue;
+        }
+
+        // Одну из параллельных стадий выполняет сам поток тика
+        std::latch done{static_cast<std::ptrdiff_t>(parallel.size() - 1)};
+        for (size_t i = 1; i < parallel.size(); ++i) {
+            net::post(*pool_, [this, info = parallel[i], delta, &done] {
+                Execute(*info, delta);
+                done.count_down();
+            });
+        }
+        Execute(*parallel.front(), delta);
+        done.wait();
+    }
+}
+
+void TickPipeline::RunBackground(StageInfo& info, std::chrono::milliseconds delta) {
+    {
+        std::lock_guard lock{info.mutex};
+        if (info.running) {
+            info.pending += delta;
+            coalesced_.Add();
+            return;
+        }
+        info.running = true;
+    }
+    net::post(*pool_, [this, &info, delta] {
+        auto next_delta = delta;
+        while (true) {
+            Execute(info, next_delta);
+            std::lock_guard lock{info.mutex};
+            if (info.pending == std::chrono::milliseconds{0}) {
+                info.running = false;
+                return;
+            }
+            next_delta = std::exchange(info.pending, std::chrono::milliseconds{0});
+        }
+    });
+}
+
+void TickPipeline::Execute(StageInfo& info, std::chrono::milliseconds delta) {
+    const auto start = Clock::now();
+    try {
+        info.stage(delta);
+    } catch (const std::exception& ex) {
+        errors_.Add();
+        logger::Logger::log_json("tick stage error", {{"stage", info.name}, {"error", ex.what()}});
+    } catch (...) {
+        errors_.Add();
+        logger::Logger::log_json("tick stage error", {{"stage", info.name}, {"error", "unknown"}});
+    }
+    info.duration_ms->Observe(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+void TickPipeline::Stop() {
+    stopped_ = true;
+    if (pool_) {
+        pool_->join();
+    }
+}
+
+} // namespace model
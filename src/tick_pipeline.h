@@ -0,0 +1,82 @@
+#ifndef GAME_SERVER_TICK_PIPELINE_H
+#define GAME_SERVER_TICK_PIPELINE_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "metrics.h"
+
+namespace model {
+
+/*
+ * Работа, выполняемая после тика игровых сессий, разбитая на именованные стадии.
+ * Стадия запускается только после всех стадий, перечисленных в её after.
+ * Стадии без зависимостей друг от друга образуют уровень: стадии INLINE уровня
+ * выполняются по очереди в потоке тика, PARALLEL - одновременно в пуле потоков,
+ * тик ждёт весь уровень. BACKGROUND выполняются в пуле без ожидания.
+ * Время каждой стадии пишется в гистограмму tick.stage.<имя>_ms.
+ * Пул создаётся при добавлении первой стадии PARALLEL или BACKGROUND: у игр без них
+ * (например, построенных только ради таблицы карт) своих потоков нет.
+ */
+class TickPipeline {
+public:
+    using Stage = std::function<void(std::chrono::milliseconds delta)>;
+
+    enum class Mode {
+        INLINE,
+        PARALLEL,
+        // Не должна трогать модель без своей синхронизации. Пока предыдущий запуск
+        // не закончился, новые не начинаются, а их время прибавляется к следующему
+        BACKGROUND
+    };
+
+    explicit TickPipeline(size_t threads = 2);
+    TickPipeline(const TickPipeline&) = delete;
+    TickPipeline& operator=(const TickPipeline&) = delete;
+    ~TickPipeline();
+
+    // Бросает std::invalid_argument, если стадия с таким именем уже есть
+    void AddStage(std::string name, Stage stage, Mode mode = Mode::INLINE, std::vector<std::string> after = {});
+    // Вызывается в потоке тика. Исключения стадий логируются и не прерывают остальные стадии
+    void Run(std::chrono::milliseconds delta);
+    // Дожидается фоновых стадий; после остановки все стадии выполняются в потоке тика
+    void Stop();
+private:
+    struct StageInfo {
+        std::string name;
+        Stage stage;
+        Mode mode;
+        std::vector<std::string> after;
+        metrics::Histogram* duration_ms;
+
+        std::mutex mutex;
+        bool running = false;
+        std::chrono::milliseconds pending{0};
+    };
+
+    // Раскладывает стадии по уровням; бросает std::logic_error при цикле или неизвестной зависимости
+    void Plan();
+    void Execute(StageInfo& stage, std::chrono::milliseconds delta);
+    void RunBackground(StageInfo& stage, std::chrono::milliseconds delta);
+private:
+    std::vector<std::unique_ptr<StageInfo>> stages_;
+    std::vector<std::vector<StageInfo*>> levels_;
+    bool planned_ = false;
+    bool stopped_ = false;
+    size_t threads_;
+    std::optional<boost::asio::thread_pool> pool_;
+
+    metrics::Counter& errors_ = metrics::Registry::get_instance().GetCounter("tick.stage_errors");
+    metrics::Counter& coalesced_ = metrics::Registry::get_instance().GetCounter("tick.stage_coalesced");
+};
+
+} // namespace model
+
+#endif //GAME_SERVER_TICK_PIPELINE_H
@@ -1,34 +1,61 @@
 #ifndef GAME_SERVER_TICKER_H
 #define GAME_SERVER_TICKER_H
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <exception>
 #include <functional>
 #include <memory>
 
+#include <boost/asio/basic_waitable_timer.hpp>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/io_context.hpp>
-#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 
+#include "logger.h"
+#include "metrics.h"
+
 namespace net = boost::asio;
 namespace sys = boost::system;
 using namespace std::chrono;
 
-class Ticker : public std::enable_shared_from_this<Ticker> {
+// Что делать с тиками, пропущенными из-за долгого обработчика
+enum class CatchUpPolicy {
+    SKIP,    // пропущенные периоды отбрасываются, обработчик получает один период
+    MERGE,   // один вызов со всем прошедшим временем
+    SUBSTEP  // по вызову на каждый пропущенный период, но не больше max_substeps
+};
+
+struct TickerOptions {
+    CatchUpPolicy catch_up = CatchUpPolicy::MERGE;
+    unsigned max_substeps = 4;
+};
+
+// Часы - параметр шаблона, чтобы тесты могли управлять временем
+template <typename ClockT>
+class BasicTicker : public std::enable_shared_from_this<BasicTicker<ClockT>> {
 public:
     using Strand = net::strand<net::io_context::executor_type>;
     using Handler = std::function<void(std::chrono::milliseconds delta)>;
-    using Clock = std::chrono::steady_clock;
+    using Clock = ClockT;
 
-    // Функция handler будет вызываться внутри strand с интервалом period
-    Ticker(Strand& strand, std::chrono::milliseconds period, Handler handler)
+    /*
+     * Функция handler будет вызываться внутри strand с интервалом period.
+     * Сроки тиков абсолютные (start + n * period), поэтому время работы
+     * обработчика не сдвигает расписание.
+     */
+    BasicTicker(Strand& strand, std::chrono::milliseconds period, Handler handler, TickerOptions options = {})
             : strand_{strand}
             , period_{period}
-            , handler_{std::move(handler)} {
+            , handler_{std::move(handler)}
+            , options_{options} {
     }
 
     void Start() {
-        net::dispatch(strand_, [self = shared_from_this()] {
+        net::dispatch(strand_, [self = this->shared_from_this()] {
             self->last_tick_ = Clock::now();
+            self->deadline_ = self->last_tick_ + self->period_;
             self->ScheduleTick();
         });
     }
@@ -36,34 +63,87 @@ public:
 private:
     void ScheduleTick() {
         assert(strand_.running_in_this_thread());
-        timer_.expires_after(period_);
-        timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
+        timer_.expires_at(deadline_);
+        timer_.async_wait([self = this->shared_from_this()](sys::error_code ec) {
             self->OnTick(ec);
         });
     }
 
     void OnTick(sys::error_code ec) {
-        using namespace std::chrono;
         assert(strand_.running_in_this_thread());
+        if (ec) {
+            return;
+        }
+
+        const auto this_tick = Clock::now();
+        const auto lateness = this_tick - deadline_;
+        jitter_ms_.Observe(duration<double, std::milli>(lateness).count());
+        // Сколько сроков целиком прошло, пока ждали этот
+        const auto periods = lateness / period_;
+        const unsigned missed = periods > 0 ? static_cast<unsigned>(periods) : 0u;
+        if (missed > 0) {
+            missed_.Add(missed);
+        }
 
-        if (!ec) {
-            auto this_tick = Clock::now();
-            auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
-            last_tick_ = this_tick;
-            try {
-                handler_(delta);
-            } catch (...) {
+        switch (options_.catch_up) {
+            case CatchUpPolicy::SKIP:
+                Run(period_);
+                last_tick_ = this_tick;
+                break;
+            case CatchUpPolicy::MERGE: {
+                // Дробная часть миллисекунды не теряется, а уходит в следующий тик
+                const auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
+                Run(delta);
+                last_tick_ += delta;
+                break;
             }
-            ScheduleTick();
+            case CatchUpPolicy::SUBSTEP: {
+                const unsigned steps = std::min(missed + 1, std::max(options_.max_substeps, 1u));
+                for (unsigned i = 0; i < steps; ++i) {
+                    Run(period_);
+                }
+                last_tick_ = this_tick;
+                break;
+            }
+        }
+
+        const auto elapsed = Clock::now() - this_tick;
+        if (elapsed > period_) {
+            overrun_ms_.Observe(duration<double, std::milli>(elapsed - period_).count());
+        }
+        deadline_ += period_ * (missed + 1);
+        ScheduleTick();
+    }
+
+    void Run(std::chrono::milliseconds delta) {
+        // Исключение не должно останавливать тики, но и теряться молча тоже
+        try {
+            handler_(delta);
+        } catch (const std::exception& ex) {
+            errors_.Add();
+            logger::Logger::log_json("tick error", {{"error", ex.what()}});
+        } catch (...) {
+            errors_.Add();
+            logger::Logger::log_json("tick error", {{"error", "unknown"}});
         }
     }
 private:
     Strand& strand_;
     std::chrono::milliseconds period_;
-    net::steady_timer timer_{strand_};
+    net::basic_waitable_timer<Clock> timer_{strand_};
     Handler handler_;
-    Clock::time_point last_tick_;
+    TickerOptions options_;
+    typename Clock::time_point last_tick_;
+    typename Clock::time_point deadline_;
+
+    // Опоздание пробуждения относительно срока тика
+    metrics::Histogram& jitter_ms_ = metrics::Registry::get_instance().GetHistogram("tick.jitter_ms");
+    // На сколько обработка тика превысила период
+    metrics::Histogram& overrun_ms_ = metrics::Registry::get_instance().GetHistogram("tick.overrun_ms");
+    metrics::Counter& missed_ = metrics::Registry::get_instance().GetCounter("tick.missed");
+    metrics::Counter& errors_ = metrics::Registry::get_instance().GetCounter("tick.errors");
 };
 
+using Ticker = BasicTicker<std::chrono::steady_clock>;
 
 #endif //GAME_SERVER_TICKER_H
@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "../src/gzip.h"
+
+using namespace std::literals;
+
+namespace {
+
+std::string Gunzip(const std::string& data) {
+    namespace bio = boost::iostreams;
+    std::string out;
+    bio::filtering_istream in;
+    in.push(bio::gzip_decompressor{});
+    in.push(bio::array_source{data.data(), data.size()});
+    bio::copy(in, bio::back_inserter(out));
+    return out;
+}
+
+std::string MakeStateLikeBody() {
+    std::string body = R"({"players":{)";
+    for (int i = 0; i < 200; ++i) {
+        body += R"(")" + std::to_string(i) + R"(":{"pos":[1.25E1,3E0],"speed":[0E0,0E0],"dir":"U","bag":[]},)";
+    }
+    body.back() = '}';
+    return body + "}";
+}
+
+} // namespace
+
+SCENARIO("Gzip response compression", "[gzip]") {
+    GIVEN("a repetitive JSON body") {
+        const auto body = MakeStateLikeBody();
+
+        THEN("it round-trips and shrinks several times") {
+            const auto gzipped = util::GzipCompress(body, 6);
+            CHECK(gzipped.size() * 5 < body.size());
+            CHECK(Gunzip(gzipped) == body);
+        }
+
+        WHEN("it is compressed through the cache") {
+            util::GzipCache cache{6, 4};
+            const auto first = cache.Compress(body);
+
+            THEN("the same body is compressed only once") {
+                CHECK(cache.Compress(body) == first);
+                CHECK(Gunzip(*first) == body);
+            }
+
+            THEN("a different body gets its own result") {
+                const auto other = cache.Compress(body + " ");
+                CHECK(other != first);
+                CHECK(Gunzip(*other) == body + " ");
+            }
+        }
+    }
+
+    GIVEN("compression options") {
+        const util::GzipOptions options{.min_size = 100, .level = 6};
+
+        THEN("small bodies and level 0 are left as is") {
+            CHECK(options.ShouldCompress(100));
+            CHECK_FALSE(options.ShouldCompress(99));
+            CHECK_FALSE(util::GzipOptions{.min_size = 0, .level = 0}.ShouldCompress(1000));
+        }
+    }
+
+    GIVEN("Accept-Encoding headers") {
+        THEN("gzip is accepted only with a positive weight") {
+            CHECK(util::AcceptsGzip("gzip"));
+            CHECK(util::AcceptsGzip("deflate, GZIP;q=0.5"));
+            CHECK(util::AcceptsGzip("br;q=1.0, x-gzip"));
+            CHECK(util::AcceptsGzip("*"));
+            CHECK_FALSE(util::AcceptsGzip(""));
+            CHECK_FALSE(util::AcceptsGzip("identity, br"));
+            CHECK_FALSE(util::AcceptsGzip("gzip;q=0"));
+            CHECK_FALSE(util::AcceptsGzip("gzip ; q=0.000, *"));
+            CHECK_FALSE(util::AcceptsGzip("*;q=0"));
+        }
+    }
+}
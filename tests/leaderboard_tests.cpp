@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/leaderboard.h"
+
+using namespace std::literals;
+
+namespace {
+
+domain::RetiredDog Record(std::string name, unsigned score, std::chrono::milliseconds play_time) {
+    return {std::move(name), score, play_time};
+}
+
+std::vector<std::string> Names(const domain::Retirees& records) {
+    std::vector<std::string> names;
+    for (const auto& record : records) {
+        names.push_back(record.name);
+    }
+    return names;
+}
+
+}  // namespace
+
+SCENARIO("Top records cache", "[leaderboard]") {
+    using leaderboard::TopRecords;
+
+    GIVEN("a cache that is not warmed up") {
+        TopRecords top;
+        THEN("it cannot answer") {
+            CHECK_FALSE(top.GetPage({0, std::nullopt, 10}).has_value());
+        }
+    }
+
+    GIVEN("a cache warmed with every record of the database") {
+        TopRecords top;
+        top.Warm({Record("a", 30, 1s), Record("b", 20, 1s)}, 3);
+
+        WHEN("records are added") {
+            top.Add({Record("d", 20, 500ms), Record("c", 20, 1s)});
+
+            THEN("pages are ordered by score, play time and name") {
+                auto page = top.GetPage({0, std::nullopt, 3});
+                REQUIRE(page.has_value());
+                CHECK(Names(*page) == std::vector<std::string>{"a", "d", "b"});
+            }
+
+            THEN("pages past the evicted record go to the database") {
+                CHECK_FALSE(top.GetPage({2, std::nullopt, 2}).has_value());
+                CHECK_FALSE(top.GetPage({0, std::nullopt, std::nullopt}).has_value());
+            }
+        }
+
+        THEN("any page is served while nothing has been evicted") {
+            auto page = top.GetPage({1, std::nullopt, 10});
+            REQUIRE(page.has_value());
+            CHECK(Names(*page) == std::vector<std::string>{"b"});
+            CHECK(top.GetPage({5, std::nullopt, 10})->empty());
+        }
+    }
+}
+
+SCENARIO("Records cursor", "[leaderboard]") {
+    using domain::RecordsCursor;
+
+    GIVEN("a cursor with an arbitrary name") {
+        const RecordsCursor cursor{7, 1500ms, "Шарик & Co", 2};
+
+        THEN("it survives encoding") {
+            const auto encoded = domain::EncodeCursor(cursor);
+            CHECK(encoded.find_first_not_of("0123456789abcdef-") == std::string::npos);
+            CHECK(domain::DecodeCursor(encoded) == cursor);
+        }
+
+        THEN("malformed cursors are rejected") {
+            CHECK_FALSE(domain::DecodeCursor("").has_value());
+            CHECK_FALSE(domain::DecodeCursor("7-1500").has_value());
+            CHECK_FALSE(domain::DecodeCursor("7-1500-2-abc").has_value());
+            CHECK_FALSE(domain::DecodeCursor("7-1500-2-zz").has_value());
+        }
+    }
+
+    GIVEN("a cache with identical records") {
+        leaderboard::TopRecords top;
+        top.Warm({Record("a", 30, 1s), Record("x", 20, 1s), Record("x", 20, 1s), Record("x", 20, 1s), Record("b", 10, 1s)}, 10);
+
+        WHEN("the table is walked page by page with cursors") {
+            std::vector<std::string> names;
+            std::optional<RecordsCursor> after;
+            for (int page_no = 0; page_no < 10; ++page_no) {
+                auto page = top.GetPage({std::nullopt, after, 2});
+                REQUIRE(page.has_value());
+                if (page->empty()) {
+                    break;
+                }
+                auto page_names = Names(*page);
+                names.insert(names.end(), page_names.begin(), page_names.end());
+                after = domain::NextCursor(*page, after);
+            }
+
+            THEN("every record is returned exactly once") {
+                CHECK(names == std::vector<std::string>{"a", "x", "x", "x", "b"});
+            }
+        }
+    }
+}
+
+SCENARIO("Single flight requests", "[leaderboard]") {
+    GIVEN("two concurrent requests for the same key") {
+        leaderboard::SingleFlight<int, int> flights;
+        std::vector<int> results;
+
+        const bool first_leads = flights.Join(1, [&results](std::exception_ptr, int value) {
+            results.push_back(value);
+        });
+        const bool second_leads = flights.Join(1, [&results](std::exception_ptr, int value) {
+            results.push_back(value);
+        });
+
+        THEN("only the first one runs the request and both get its result") {
+            CHECK(first_leads);
+            CHECK_FALSE(second_leads);
+            flights.Complete(1, nullptr, 42);
+            CHECK(results == std::vector<int>{42, 42});
+            CHECK(flights.Join(1, [](std::exception_ptr, int) {}));
+        }
+    }
+}
@@ -1,9 +1,13 @@
 #include <cmath>
+#include <filesystem>
+#include <set>
 #include <catch2/catch_test_macros.hpp>
 
+#include "../src/app.h"
 #include "../src/model_dog.h"
 #include "../src/model.h"
 #include "../src/loot.h"
+#include "../src/record_log.h"
 
 using namespace std::literals;
 
@@ -56,3 +60,504 @@ SCENARIO("Game model", "[model]") {
         REQUIRE(session->GetLoots().size() <= 1);
     }
 }
+
+SCENARIO("Dog input mailbox", "[model]") {
+    GIVEN("An empty mailbox") {
+        model::DogInput input;
+        REQUIRE_FALSE(input.Take().has_value());
+
+        WHEN("several directions are posted before the tick") {
+            input.Post(model::Direction::NORTH);
+            input.Post(model::Direction::WEST);
+            input.Post(model::Direction::NONE);
+
+            THEN("the last one wins and is taken only once") {
+                REQUIRE(input.GetSequence() == 3);
+                auto direction = input.Take();
+                REQUIRE(direction.has_value());
+                REQUIRE(*direction == model::Direction::NONE);
+                REQUIRE_FALSE(input.Take().has_value());
+            }
+        }
+    }
+}
+
+SCENARIO("Session change tracking", "[model]") {
+    GIVEN("A session with two dogs") {
+        auto game = std::make_shared<model::Game>();
+        game->SetDefaultSpeed(1.0f);
+        game->SetDefaultBagSize(1);
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"golden_coin", "", ""}}}});
+
+        auto session = game->GetSession(map);
+        session->AddDog(0, "first");
+        session->AddDog(1, "second");
+
+        THEN("everything is a change since the beginning") {
+            auto changes = session->GetChangesSince(0);
+            REQUIRE(changes.has_value());
+            CHECK(changes->dogs.size() == 2);
+            CHECK(changes->removed_dogs.empty());
+        }
+
+        WHEN("the version is closed") {
+            session->CloseVersion();
+            const auto version = session->GetVersion();
+            REQUIRE(session->GetChangesSince(version)->IsEmpty());
+
+            AND_WHEN("a dog is removed") {
+                session->RemoveDog(1);
+
+                THEN("only its tombstone is reported") {
+                    auto changes = session->GetChangesSince(version);
+                    REQUIRE(changes.has_value());
+                    CHECK(changes->dogs.empty());
+                    REQUIRE(changes->removed_dogs.size() == 1);
+                    CHECK(changes->removed_dogs.front() == 1);
+                }
+            }
+
+            AND_WHEN("the reader falls far behind") {
+                for (int i = 0; i < 2000; ++i) {
+                    session->CloseVersion();
+                }
+
+                THEN("a full state is required") {
+                    CHECK_FALSE(session->GetChangesSince(version).has_value());
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Session snapshots", "[model]") {
+    GIVEN("A session with a moving dog") {
+        auto game = std::make_shared<model::Game>();
+        game->SetDefaultSpeed(1.0f);
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"golden_coin", "", ""}}}});
+
+        auto session = game->GetSession(map);
+        session->AddDog(0, "dog");
+        session->SetDogDirection(0, model::Direction::SOUTH);
+        const auto start = session->GetDogs().front().GetPosition();
+
+        WHEN("a snapshot is held during a tick") {
+            const auto snapshot = session->GetSnapshot();
+            session->Tick(1000);
+            session->UpsertLoot({1, 0, {0.0, 5.0}});
+
+            THEN("the snapshot keeps the state before the tick") {
+                REQUIRE(snapshot.dogs->size() == 1);
+                CHECK(snapshot.dogs->front().GetPosition() == start);
+                CHECK(snapshot.loots->empty());
+                CHECK(snapshot.now == 0ms);
+            }
+
+            THEN("the session has moved on") {
+                CHECK(session->GetDogs().front().GetPosition() != start);
+                CHECK(session->GetLoots().size() == 1);
+                CHECK(session->GetNow() == 1000ms);
+            }
+        }
+
+        WHEN("the snapshot is released before the tick") {
+            const std::vector<model::Dog>* captured = nullptr;
+            {
+                const auto snapshot = session->GetSnapshot();
+                captured = snapshot.dogs.get();
+            }
+            session->Tick(1000);
+
+            THEN("the dogs are changed in place") {
+                CHECK(&session->GetDogs() == captured);
+                CHECK(session->GetDogs().front().GetPosition() != start);
+            }
+        }
+    }
+}
+
+SCENARIO("Dog retirement deadlines", "[model]") {
+    GIVEN("A session with a running dog and an idle dog") {
+        auto game = std::make_shared<model::Game>();
+        game->SetDefaultSpeed(1.0f);
+        game->SetRetirementTime(1.0);
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.SetSpeed(1.0);
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"golden_coin", "", ""}}}});
+
+        auto session = game->GetSession(map);
+        session->AddDog(0, "runner");
+        session->AddDog(1, "sleeper");
+        session->SetDogDirection(0, model::Direction::SOUTH);
+
+        WHEN("less than the retirement time passes") {
+            session->Tick(600);
+
+            THEN("nobody retires") {
+                CHECK(session->TakeRetiredDogs(game->GetRetirementTime()).empty());
+                CHECK(session->GetDogs().size() == 2);
+            }
+
+            AND_WHEN("the idle dog reaches its deadline") {
+                session->Tick(600);
+
+                THEN("only the idle dog retires") {
+                    auto retired = session->TakeRetiredDogs(game->GetRetirementTime());
+                    REQUIRE(retired.size() == 1);
+                    CHECK(retired.front().GetIdValue() == 1);
+                    REQUIRE(session->GetDogs().size() == 1);
+                    CHECK(session->GetNonactiveTime(session->GetDogs().front()) == 0ms);
+                    CHECK(session->GetDogInput(0) != nullptr);
+                    CHECK(session->GetDogInput(1) == nullptr);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Seeded session randomness", "[model]") {
+    auto make_game = [](uint64_t seed) {
+        auto game = std::make_shared<model::Game>();
+        game->SetSeed(seed);
+        game->SetRandomSpawn(true);
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 1.0));
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.AddRoad(model::Road{{0, 0}, {0, 100}});
+        map.AddRoad(model::Road{{0, 100}, {100, 100}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}, {"wallet", "", ""}}}});
+        auto session = game->GetSession(map);
+        for (uint64_t id = 0; id < 8; ++id) {
+            session->AddDog(id, "dog");
+        }
+        session->Tick(1000.0);
+        return session;
+    };
+
+    GIVEN("Two games with the same seed") {
+        auto first = make_game(42);
+        auto second = make_game(42);
+
+        THEN("dogs and loot appear at the same places") {
+            const auto first_dogs = first->GetDogs();
+            const auto second_dogs = second->GetDogs();
+            REQUIRE(first_dogs.size() == second_dogs.size());
+            for (size_t i = 0; i < first_dogs.size(); ++i) {
+                CHECK(first_dogs[i].GetPosition() == second_dogs[i].GetPosition());
+            }
+            const auto first_loots = first->GetLoots();
+            const auto second_loots = second->GetLoots();
+            REQUIRE(first_loots.size() == 8);
+            REQUIRE(first_loots.size() == second_loots.size());
+            for (const auto& [id, loot] : first_loots) {
+                CHECK(loot.type == second_loots.at(id).type);
+                CHECK(loot.pos == second_loots.at(id).pos);
+            }
+        }
+    }
+
+    GIVEN("Different stream numbers of one seed") {
+        util::Xoshiro256 first{42, 0};
+        util::Xoshiro256 second{42, 1};
+
+        THEN("the streams differ") {
+            CHECK(first() != second());
+        }
+    }
+}
+
+SCENARIO("Length-weighted spawn sampling", "[model]") {
+    GIVEN("A long road and a short road") {
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.AddRoad(model::Road{{0, 0}, {0, 900}});
+        map.AddRoad(model::Road{{0, 1000}, {100, 1000}});
+        map.PrepareSpawns();
+        util::Xoshiro256 rng{7};
+
+        WHEN("many points are sampled in one batch") {
+            std::vector<model::Point2D> points;
+            map.GetSpawns().Sample(rng, 20'000, std::back_inserter(points));
+
+            THEN("every point lies on a road and roads are hit by their length") {
+                REQUIRE(points.size() == 20'000);
+                size_t on_long_road = 0;
+                for (const auto& point : points) {
+                    const bool on_long = point.x == 0.0 && point.y >= 0.0 && point.y <= 900.0;
+                    const bool on_short = point.y == 1000.0 && point.x >= 0.0 && point.x <= 100.0;
+                    REQUIRE((on_long || on_short));
+                    on_long_road += on_long ? 1 : 0;
+                }
+                CHECK(on_long_road > 17'600);
+                CHECK(on_long_road < 18'400);
+            }
+        }
+    }
+}
+
+SCENARIO("Map table reload", "[model]") {
+    GIVEN("A session on the first version of a map") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+        auto old_session = game->GetSession(map);
+        old_session->AddDog(0, "old");
+        const auto old_map = game->FindMap(map.GetId());
+
+        WHEN("a new map table is published") {
+            auto table = std::make_shared<model::MapTable>();
+            model::Map updated{model::Map::Id{"test_map_0"}, "Test Map 0 v2"};
+            updated.AddRoad(model::Road{{0, 0}, {20, 0}});
+            table->Add(updated);
+            table->Add(model::Map{model::Map::Id{"test_map_1"}, "Test Map 1"});
+            table->loot_data = {{updated.GetId(), loot::MapLootTypes{{"key", "", ""}}}};
+            game->SetMapTable(table);
+
+            THEN("the old session keeps its map version") {
+                CHECK(old_session->GetMap() == old_map);
+                CHECK(game->FindMap(map.GetId())->GetName() == "Test Map 0 v2");
+                CHECK(game->FindMap(model::Map::Id{"test_map_1"}) != nullptr);
+            }
+
+            AND_WHEN("a player joins the reloaded map") {
+                auto new_session = game->GetSession(*game->FindMap(map.GetId()));
+
+                THEN("a session of the new version is created") {
+                    CHECK(new_session != old_session);
+                    CHECK(new_session->GetMap()->GetName() == "Test Map 0 v2");
+                    CHECK(game->GetSessions().size() == 2);
+                }
+
+                AND_WHEN("the old session becomes empty") {
+                    old_session->RemoveDog(0);
+                    game->TickAllSessions(10ms);
+
+                    THEN("it is dropped on the next tick") {
+                        REQUIRE(game->GetSessions().size() == 1);
+                        CHECK(game->GetSessions().begin()->second == new_session);
+                    }
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Session ids", "[model]") {
+    GIVEN("Sessions on two maps, the newest on a map that is about to be replaced") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map_0{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map_0.AddRoad(model::Road{{0, 0}, {0, 10}});
+        model::Map map_1{model::Map::Id{"test_map_1"}, "Test Map 1"};
+        map_1.AddRoad(model::Road{{0, 0}, {10, 0}});
+        game->AddMap(map_0);
+        game->AddMap(map_1);
+        game->SetLootData({{map_0.GetId(), loot::MapLootTypes{{"key", "", ""}}},
+                           {map_1.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+        game->GetSession(map_0)->AddDog(0, "first");
+        REQUIRE(game->GetSession(map_1)->GetIdValue() == 1);
+
+        WHEN("the map is reloaded and its empty session is dropped") {
+            auto table = std::make_shared<model::MapTable>();
+            model::Map updated{model::Map::Id{"test_map_1"}, "Test Map 1 v2"};
+            updated.AddRoad(model::Road{{0, 0}, {20, 0}});
+            table->Add(map_0);
+            table->Add(updated);
+            table->loot_data = {{map_0.GetId(), loot::MapLootTypes{{"key", "", ""}}},
+                                {updated.GetId(), loot::MapLootTypes{{"key", "", ""}}}};
+            game->SetMapTable(table);
+            game->TickAllSessions(10ms);
+            REQUIRE(game->FindSession(model::GameSession::Id{1}) == nullptr);
+
+            THEN("the next session does not get the dropped id back") {
+                CHECK(game->GetSession(*game->FindMap(map_1.GetId()))->GetIdValue() == 2);
+            }
+        }
+
+        WHEN("the next id is restored lower than the issued ones") {
+            game->SetNextSessionId(1);
+
+            THEN("it is not moved back") {
+                CHECK(game->GetNextSessionId() == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("Batch player creation", "[app]") {
+    GIVEN("An empty player registry") {
+        app::Players players;
+        const model::GameSession::Id sess_0{0};
+        const model::GameSession::Id sess_1{1};
+
+        WHEN("a batch is added") {
+            auto added = players.AddBatch({{"a", sess_0}, {"b", sess_1}, {"c", sess_0}});
+
+            THEN("ids start from zero and go in the batch order") {
+                REQUIRE(added.size() == 3);
+                for (size_t i = 0; i < added.size(); ++i) {
+                    CHECK(added[i]->GetIdValue() == i);
+                }
+                CHECK(added[1]->GetDogName() == "b");
+                CHECK(added[1]->GetSessionId() == sess_1);
+            }
+
+            THEN("every player gets its own token and is found by it") {
+                std::set<app::Token> tokens;
+                for (const auto& player : added) {
+                    CHECK(player->GetTokenValue().size() == app::TOKEN_LENGTH);
+                    tokens.insert(player->GetTokenValue());
+                    auto found = players.GetPlayer(player->GetTokenValue());
+                    REQUIRE(found.has_value());
+                    CHECK(*found == player);
+                }
+                CHECK(tokens.size() == added.size());
+            }
+
+            AND_WHEN("another batch is added") {
+                auto more = players.AddBatch({{"d", sess_1}});
+
+                THEN("its ids continue after the first one") {
+                    REQUIRE(more.size() == 1);
+                    CHECK(more.front()->GetIdValue() == 3);
+                    CHECK(players.GetPlayers().size() == 4);
+                }
+            }
+        }
+
+        WHEN("an empty batch is added") {
+            THEN("nothing changes") {
+                CHECK(players.AddBatch({}).empty());
+                CHECK(players.GetPlayers().empty());
+            }
+        }
+
+        WHEN("players are restored with ids that have gaps") {
+            players.Add("old_a", sess_0, 3, app::Token(app::TOKEN_LENGTH, 'a'));
+            players.Add("old_b", sess_0, 41, app::Token(app::TOKEN_LENGTH, 'b'));
+            auto added = players.AddBatch({{"new_a", sess_0}, {"new_b", sess_0}});
+
+            THEN("a batch continues after the largest id") {
+                REQUIRE(added.size() == 2);
+                CHECK(added[0]->GetIdValue() == 42);
+                CHECK(added[1]->GetIdValue() == 43);
+                CHECK(players.GetPlayer(app::Token(app::TOKEN_LENGTH, 'b')).has_value());
+            }
+        }
+    }
+}
+
+SCENARIO("Player snapshots", "[app]") {
+    GIVEN("A registry with a player") {
+        app::Players players;
+        players.Add("a", model::GameSession::Id{0});
+        const auto snapshot = players.GetSnapshot();
+
+        WHEN("players join and leave while the snapshot is held") {
+            players.AddBatch({{"b", model::GameSession::Id{0}}});
+            players.DeletePlayer(0);
+
+            THEN("the snapshot keeps the players it was taken with") {
+                REQUIRE(snapshot->size() == 1);
+                CHECK(snapshot->at(0)->GetDogName() == "a");
+                REQUIRE(players.GetPlayers().size() == 1);
+                CHECK(players.GetPlayers().begin()->first == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Batch join", "[app]") {
+    namespace fs = std::filesystem;
+    const fs::path records_path = fs::temp_directory_path() / "game_server_model_test_records.log";
+    const fs::path spool_path = fs::temp_directory_path() / "game_server_model_test_spool.log";
+    fs::remove(records_path);
+    fs::remove(spool_path);
+
+    GIVEN("An application with two maps") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map_0{model::Map::Id{"test_map_0"}, "Test Map 0"};
+        map_0.AddRoad(model::Road{{0, 0}, {0, 10}});
+        model::Map map_1{model::Map::Id{"test_map_1"}, "Test Map 1"};
+        map_1.AddRoad(model::Road{{0, 0}, {10, 0}});
+        game->AddMap(map_0);
+        game->AddMap(map_1);
+        game->SetLootData({{map_0.GetId(), loot::MapLootTypes{{"key", "", ""}}},
+                           {map_1.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+
+        db::EmbeddedRecordStore store{records_path};
+        db::RecordLog spool{spool_path};
+        db::RecordWriter writer{store, spool, {}};
+        app::App application{game, store, writer};
+        const auto* first = game->FindMap(map_0.GetId()).get();
+        const auto* second = game->FindMap(map_1.GetId()).get();
+
+        WHEN("players join both maps in one batch") {
+            auto joined = application.JoinGameBatch({{"a", first}, {"b", second}, {"c", first}});
+
+            THEN("results go in the request order with consecutive ids") {
+                REQUIRE(joined.size() == 3);
+                for (size_t i = 0; i < joined.size(); ++i) {
+                    CHECK(joined[i].first == i);
+                }
+            }
+
+            THEN("each dog is placed in the session of its map") {
+                auto first_session = game->GetSession(*first);
+                auto second_session = game->GetSession(*second);
+                REQUIRE(first_session->GetDogs().size() == 2);
+                REQUIRE(second_session->GetDogs().size() == 1);
+                CHECK(second_session->GetDogs().front().GetName() == "b");
+                CHECK(application.GetPlayerSession(joined[1].second) == second_session);
+            }
+
+            THEN("players can move right away") {
+                for (const auto& [id, token] : joined) {
+                    CHECK(application.MovePlayer(token, model::Direction::EAST));
+                    auto player = application.GetPlayer(token);
+                    REQUIRE(player.has_value());
+                    REQUIRE((*player)->GetInput() != nullptr);
+                    CHECK((*player)->GetInput()->GetSequence() == 1);
+                }
+            }
+
+            AND_WHEN("a single player joins afterwards") {
+                auto [id, token] = application.JoinGame("d", *second);
+
+                THEN("its id follows the batch") {
+                    CHECK(id == 3);
+                }
+            }
+        }
+
+        WHEN("players were restored before the batch") {
+            app::Players restored;
+            restored.Add("old", model::GameSession::Id{0}, 5, app::Token(app::TOKEN_LENGTH, 'a'));
+            application.RestorePlayers(restored);
+            auto joined = application.JoinGameBatch({{"a", first}, {"b", first}});
+
+            THEN("new ids continue after the restored ones") {
+                REQUIRE(joined.size() == 2);
+                CHECK(joined[0].first == 6);
+                CHECK(joined[1].first == 7);
+            }
+        }
+    }
+
+    fs::remove(records_path);
+    fs::remove(spool_path);
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/metrics.h"
+#include "../src/record_log.h"
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<std::string> Names(const domain::Retirees& records) {
+    std::vector<std::string> names;
+    for (const auto& record : records) {
+        names.push_back(record.name);
+    }
+    return names;
+}
+
+// Хранилище, которое по команде теста отказывает или зависает на записи
+class FakeRecordStore final : public db::RecordStore {
+public:
+    void SaveBatch(const domain::Retirees& dogs) override {
+        std::unique_lock lock{mutex_};
+        ++save_calls_;
+        cond_var_.wait(lock, [this] { return !hanging_; });
+        if (failing_) {
+            throw std::runtime_error("Store is down");
+        }
+        saved_.insert(saved_.end(), dogs.begin(), dogs.end());
+    }
+
+    domain::Retirees GetRetiredDogs(const domain::RecordsQuery&) override {
+        std::lock_guard lock{mutex_};
+        if (failing_) {
+            throw std::runtime_error("Store is down");
+        }
+        return {};
+    }
+
+    [[nodiscard]] boost::asio::any_io_executor GetExecutor() override {
+        return ioc_.get_executor();
+    }
+
+    void SetFailing(bool failing) {
+        std::lock_guard lock{mutex_};
+        failing_ = failing;
+    }
+
+    void SetHanging(bool hanging) {
+        {
+            std::lock_guard lock{mutex_};
+            hanging_ = hanging;
+        }
+        cond_var_.notify_all();
+    }
+
+    [[nodiscard]] std::vector<std::string> GetSavedNames() const {
+        std::lock_guard lock{mutex_};
+        auto names = Names(saved_);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+    [[nodiscard]] size_t GetSaveCalls() const {
+        std::lock_guard lock{mutex_};
+        return save_calls_;
+    }
+protected:
+    void DoAsyncGetRetiredDogs(domain::RecordsQuery query, Callback callback) override {
+        callback(nullptr, GetRetiredDogs(query));
+    }
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cond_var_;
+    bool failing_ = false;
+    bool hanging_ = false;
+    size_t save_calls_ = 0;
+    domain::Retirees saved_;
+    boost::asio::io_context ioc_;
+};
+
+// Ждёт условия, которое выполняют фоновые потоки RecordWriter
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(5ms);
+    }
+    return true;
+}
+
+}  // namespace
+
+SCENARIO("Record writer circuit breaker", "[records]") {
+    using State = db::RecordWriter::BreakerState;
+    const fs::path spool_path = fs::temp_directory_path() / "game_server_record_writer_spool.log";
+    fs::remove(spool_path);
+    const auto& state_gauge = metrics::Registry::get_instance().GetGauge("records.breaker.state");
+
+    GIVEN("a writer over a store that goes down") {
+        FakeRecordStore store;
+        db::RecordLog spool{spool_path};
+        db::RecordWriter writer{store, spool, {.max_queue = 10'000, .max_delay = 500ms, .retry_delay = 100ms}};
+        store.SetFailing(true);
+        writer.Save({{"a", 10, 1s}});
+
+        REQUIRE(WaitFor([&] { return writer.GetBreakerState() == State::OPEN && spool.GetRecordCount() == 1; }));
+        CHECK(state_gauge.Get() == static_cast<double>(State::OPEN));
+
+        WHEN("the store is still down when the breaker half-opens") {
+            const auto calls = store.GetSaveCalls();
+            REQUIRE(WaitFor([&] { return store.GetSaveCalls() > calls; }));
+
+            THEN("the probe is a real write, it fails and the records stay in the spool") {
+                REQUIRE(WaitFor([&] { return writer.GetBreakerState() == State::OPEN; }));
+                CHECK(spool.GetRecordCount() == 1);
+                CHECK(store.GetSavedNames().empty());
+            }
+        }
+
+        WHEN("the store comes back but the probe hangs") {
+            store.SetFailing(false);
+            store.SetHanging(true);
+            REQUIRE(WaitFor([&] { return writer.GetBreakerState() == State::HALF_OPEN; }));
+            CHECK(state_gauge.Get() == static_cast<double>(State::HALF_OPEN));
+
+            THEN("the guard opens the breaker, and once the store answers everything is written exactly once") {
+                REQUIRE(WaitFor([&] { return writer.GetBreakerState() == State::OPEN; }));
+                // Хранилище считается недоступным - новые записи идут в spool
+                writer.Save({{"b", 20, 1s}});
+                REQUIRE(WaitFor([&] { return spool.GetRecordCount() == 2; }));
+
+                store.SetHanging(false);
+                REQUIRE(WaitFor([&] {
+                    return writer.GetBreakerState() == State::CLOSED && spool.GetRecordCount() == 0
+                           && store.GetSavedNames().size() == 2;
+                }));
+                CHECK(state_gauge.Get() == static_cast<double>(State::CLOSED));
+
+                writer.Save({{"c", 30, 1s}});
+                writer.Stop();
+                CHECK(store.GetSavedNames() == std::vector<std::string>{"a", "b", "c"});
+                CHECK(spool.GetRecordCount() == 0);
+            }
+        }
+
+        store.SetHanging(false);
+        writer.Stop();
+    }
+
+    fs::remove(spool_path);
+}
+
+SCENARIO("Embedded record store", "[records]") {
+    const fs::path path = fs::temp_directory_path() / "game_server_record_log_test.log";
+    fs::remove(path);
+
+    GIVEN("a store with records written in several batches") {
+        {
+            db::EmbeddedRecordStore store{path};
+            store.SaveBatch({{"b", 10, 1s}, {"a", 30, 2s}});
+            store.SaveBatch({{"c", 30, 1s}});
+        }
+
+        WHEN("the store is reopened") {
+            db::EmbeddedRecordStore store{path};
+
+            THEN("records are read back in the leaderboard order") {
+                CHECK(Names(store.GetRetiredDogs({})) == std::vector<std::string>{"c", "a", "b"});
+            }
+
+            THEN("pages are taken by offset or by cursor") {
+                CHECK(Names(store.GetRetiredDogs({1, std::nullopt, 1})) == std::vector<std::string>{"a"});
+                CHECK(Names(store.GetRetiredDogs({std::nullopt, domain::RecordsCursor{30, 2000ms, "a", 1}, 5}))
+                      == std::vector<std::string>{"b"});
+            }
+
+            THEN("a later batch is merged into the order, equal records included") {
+                store.SaveBatch({{"d", 20, 1s}, {"a", 30, 2s}});
+                CHECK(Names(store.GetRetiredDogs({})) == std::vector<std::string>{"c", "a", "a", "d", "b"});
+                CHECK(Names(store.GetRetiredDogs({std::nullopt, domain::RecordsCursor{30, 2000ms, "a", 1}, 5}))
+                      == std::vector<std::string>{"a", "d", "b"});
+                CHECK(store.GetRetiredDogs({10, std::nullopt, 5}).empty());
+            }
+
+            THEN("a batch larger than the file is appended") {
+                const std::string long_name(1 << 20, 'x');
+                store.SaveBatch({{long_name, 40, 1s}, {long_name, 5, 1s}});
+                CHECK(store.GetRetiredDogs({}).size() == 5);
+                CHECK(store.GetRetiredDogs({0, std::nullopt, 1}).front().score == 40);
+            }
+        }
+    }
+
+    fs::remove(path);
+}
+
+SCENARIO("Records spool", "[records]") {
+    const fs::path path = fs::temp_directory_path() / "game_server_record_spool_test.log";
+    fs::remove(path);
+
+    GIVEN("a spool with records") {
+        db::RecordLog spool{path};
+        spool.Append({{"a", 1, 1s}, {"b", 2, 1s}});
+
+        WHEN("records are read and more are appended before consuming") {
+            auto contents = spool.ReadAll();
+            spool.Append({{"c", 3, 1s}});
+            spool.Consume(contents);
+
+            THEN("only the read records are removed") {
+                CHECK(Names(contents.records) == std::vector<std::string>{"a", "b"});
+                CHECK(spool.GetRecordCount() == 1);
+                CHECK(Names(db::RecordLog{path}.ReadAll().records) == std::vector<std::string>{"c"});
+            }
+        }
+
+        WHEN("everything is consumed") {
+            spool.Consume(spool.ReadAll());
+
+            THEN("the spool is empty after reopening") {
+                CHECK(spool.GetRecordCount() == 0);
+                CHECK(db::RecordLog{path}.GetRecordCount() == 0);
+            }
+        }
+    }
+
+    fs::remove(path);
+}
@@ -0,0 +1,58 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/rendered_maps.h"
+
+using namespace std::literals;
+
+SCENARIO("Pre-rendered map responses", "[maps]") {
+    GIVEN("a map table with one map") {
+        auto table = std::make_shared<model::MapTable>();
+        model::Map map{model::Map::Id{"map1"}, "Map 1"};
+        map.AddRoad(model::Road{{0, 0}, {10, 0}});
+        table->Add(map);
+        table->loot_data = {{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}};
+        const model::RenderedMaps rendered{table};
+
+        THEN("the list and the map are rendered once and shared") {
+            REQUIRE(rendered.GetList() == rendered.GetList());
+            CHECK(rendered.GetList()->body.find(R"("id":"map1")") != std::string::npos);
+            auto first = rendered.GetMap(map.GetId());
+            REQUIRE(first);
+            CHECK(first == rendered.GetMap(map.GetId()));
+            CHECK(first->body.find(R"("lootTypes")") != std::string::npos);
+            CHECK(first->etag != rendered.GetList()->etag);
+        }
+
+        THEN("bodies below the gzip threshold are not compressed") {
+            CHECK(rendered.GetList()->gzip_body.empty());
+        }
+
+        THEN("an unknown map is not rendered") {
+            CHECK(rendered.GetMap(model::Map::Id{"map2"}) == nullptr);
+        }
+
+        WHEN("every body is worth compressing") {
+            const model::RenderedMaps gzipped{table, util::GzipOptions{.min_size = 0, .level = 6}};
+
+            THEN("the compressed body is prepared along with the plain one") {
+                const auto list = gzipped.GetList();
+                CHECK(!list->gzip_body.empty());
+                CHECK(list->body == rendered.GetList()->body);
+                CHECK(!gzipped.GetMap(map.GetId())->gzip_body.empty());
+            }
+        }
+
+        WHEN("a client revalidates") {
+            const auto& list = *rendered.GetList();
+
+            THEN("its tag is recognized in any form") {
+                CHECK(list.MatchesETag(list.etag));
+                CHECK(list.MatchesETag("W/" + list.etag));
+                CHECK(list.MatchesETag(R"("other", )" + list.etag));
+                CHECK(list.MatchesETag("*"));
+                CHECK_FALSE(list.MatchesETag(R"("other")"));
+                CHECK_FALSE(list.MatchesETag(""));
+            }
+        }
+    }
+}
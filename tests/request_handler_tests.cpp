@@ -0,0 +1,313 @@
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/record_log.h"
+#include "../src/request_handler.h"
+
+using namespace std::literals;
+namespace fs = std::filesystem;
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+namespace {
+
+std::shared_ptr<model::Game> MakeGame() {
+    auto game = std::make_shared<model::Game>();
+    game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+    model::Map map{model::Map::Id{"map1"}, "Map 1"};
+    map.AddRoad(model::Road{{0, 0}, {40, 0}});
+    map.AddRoad(model::Road{{40, 0}, {40, 30}});
+    game->AddMap(map);
+    game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "assets/key.obj", "obj"}}}});
+    return game;
+}
+
+http_handler::StrReqt MakeGet(std::string_view target, std::string_view accept_encoding = {}) {
+    http_handler::StrReqt req{http::verb::get, target, 11};
+    if (!accept_encoding.empty()) {
+        req.set(http::field::accept_encoding, accept_encoding);
+    }
+    return req;
+}
+
+http_handler::StrReqt MakePost(std::string_view target, std::string body) {
+    http_handler::StrReqt req{http::verb::post, target, 11};
+    req.set(http::field::content_type, "application/json");
+    req.body() = std::move(body);
+    req.prepare_payload();
+    return req;
+}
+
+// JSON-массив из count одинаковых элементов
+std::string RepeatJson(std::string_view item, size_t count) {
+    std::string body{"["};
+    body.reserve(count * (item.size() + 1) + 2);
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            body += ',';
+        }
+        body += item;
+    }
+    body += ']';
+    return body;
+}
+
+// Игра, хранилище рекордов и strand для APIHandler
+struct HandlerEnv {
+    HandlerEnv() {
+        fs::remove(records_path);
+        fs::remove(spool_path);
+    }
+    ~HandlerEnv() {
+        writer.Stop();
+        fs::remove(records_path);
+        fs::remove(spool_path);
+    }
+
+    const fs::path records_path = fs::temp_directory_path() / "game_server_handler_test_records.log";
+    const fs::path spool_path = fs::temp_directory_path() / "game_server_handler_test_spool.log";
+    db::EmbeddedRecordStore store{records_path};
+    db::RecordLog spool{spool_path};
+    db::RecordWriter writer{store, spool, {}};
+    app::App app{MakeGame(), store, writer};
+    net::io_context ioc;
+};
+
+}  // namespace
+
+SCENARIO("Compression settings of map responses", "[handler][gzip]") {
+    HandlerEnv env;
+
+    GIVEN("a handler that compresses every body") {
+        http_handler::APIHandler api{env.app, net::make_strand(env.ioc), util::GzipOptions{.min_size = 0, .level = 6}};
+
+        THEN("the map list and a map are sent compressed to clients that accept gzip") {
+            for (auto target : {"/api/v1/maps"sv, "/api/v1/maps/map1"sv}) {
+                const auto resp = api.Response(MakeGet(target, "gzip"));
+                CHECK(resp.result() == http::status::ok);
+                CHECK(resp[http::field::content_encoding] == "gzip");
+                CHECK(resp[http::field::vary] == "Accept-Encoding");
+            }
+        }
+
+        THEN("other clients get the plain body") {
+            const auto resp = api.Response(MakeGet("/api/v1/maps"));
+            CHECK(resp.count(http::field::content_encoding) == 0);
+            CHECK(resp.body().starts_with("["));
+        }
+    }
+
+    GIVEN("a handler with compression turned off") {
+        http_handler::APIHandler api{env.app, net::make_strand(env.ioc), util::GzipOptions{.min_size = 0, .level = 0}};
+
+        THEN("maps are never compressed") {
+            for (auto target : {"/api/v1/maps"sv, "/api/v1/maps/map1"sv}) {
+                CHECK(api.Response(MakeGet(target, "gzip")).count(http::field::content_encoding) == 0);
+            }
+        }
+    }
+
+    GIVEN("a handler with a threshold above the map bodies") {
+        http_handler::APIHandler api{env.app, net::make_strand(env.ioc), util::GzipOptions{.min_size = 1 << 20, .level = 6}};
+
+        THEN("maps are sent as is") {
+            const auto resp = api.Response(MakeGet("/api/v1/maps/map1", "gzip"));
+            CHECK(resp.count(http::field::content_encoding) == 0);
+            CHECK(resp.count(http::field::vary) == 0);
+        }
+    }
+}
+
+SCENARIO("Game state responses", "[handler][gzip]") {
+    HandlerEnv env;
+    auto strand = net::make_strand(env.ioc);
+    http_handler::APIHandler api{env.app, strand, util::GzipOptions{.min_size = 0, .level = 6}};
+    const auto map = env.app.GetGame()->FindMap(model::Map::Id{"map1"});
+    REQUIRE(map);
+    const auto token = env.app.JoinGame("dog", *map).second;
+
+    GIVEN("a client that accepts gzip") {
+        auto req = MakeGet("/api/v1/game/state", "gzip");
+        req.set(http::field::authorization, "Bearer " + token);
+        REQUIRE(http_handler::APIHandler::IsAsync(req.target()));
+
+        WHEN("the state is requested") {
+            std::optional<http_handler::StrResp> resp;
+            bool on_strand = true;
+            api.AsyncResponse(std::move(req), [&resp, &on_strand, &strand](http_handler::StrResp&& result) {
+                on_strand = strand.running_in_this_thread();
+                resp = std::move(result);
+            });
+            env.ioc.run();
+
+            THEN("it is compressed and sent outside the simulation strand") {
+                REQUIRE(resp);
+                CHECK(resp->result() == http::status::ok);
+                CHECK(resp->at(http::field::content_encoding) == "gzip");
+                CHECK_FALSE(on_strand);
+            }
+        }
+    }
+}
+
+SCENARIO("Long-poll state waiters", "[handler][long-poll]") {
+    HandlerEnv env;
+    auto strand = net::make_strand(env.ioc);
+    http_handler::APIHandler api{env.app, strand};
+    const auto map = env.app.GetGame()->FindMap(model::Map::Id{"map1"});
+    REQUIRE(map);
+    const auto first_token = env.app.JoinGame("first", *map).second;
+    const auto second_token = env.app.JoinGame("second", *map).second;
+    const auto version = env.app.GetPlayerSession(first_token)->GetVersion();
+
+    std::vector<http_handler::StrResp> responses;
+    auto wait = [&](const std::string& token) {
+        auto req = MakeGet("/api/v1/game/state?since=" + std::to_string(version) + "&timeout=30000");
+        req.set(http::field::authorization, "Bearer " + token);
+        api.AsyncResponse(std::move(req), [&responses](http_handler::StrResp&& resp) {
+            responses.push_back(std::move(resp));
+        });
+    };
+    auto wake = [&] {
+        net::dispatch(strand, [&api] {
+            api.WakeStateWaiters();
+        });
+        env.ioc.run();
+    };
+
+    WHEN("players of one session wait for the same version") {
+        wait(first_token);
+        wait(second_token);
+        env.ioc.poll();
+        REQUIRE(responses.empty());
+        wake();
+
+        THEN("the tick answers both with the same changes") {
+            REQUIRE(responses.size() == 2);
+            CHECK(responses[0].result() == http::status::ok);
+            CHECK(responses[0].body() == responses[1].body());
+        }
+    }
+
+    WHEN("more requests wait than the handler keeps") {
+        for (size_t i = 0; i <= http_handler::APIHandler::MAX_STATE_WAITERS; ++i) {
+            wait(first_token);
+        }
+        env.ioc.poll();
+
+        THEN("the overflow is answered at once and the rest on the tick") {
+            REQUIRE(responses.size() == 1);
+            CHECK(responses.front().result() == http::status::ok);
+            wake();
+            CHECK(responses.size() == http_handler::APIHandler::MAX_STATE_WAITERS + 1);
+        }
+    }
+}
+
+SCENARIO("Batch joins", "[handler][batch]") {
+    HandlerEnv env;
+    http_handler::APIHandler api{env.app, net::make_strand(env.ioc)};
+    constexpr size_t MAX_BATCH_JOINS = 10'000;
+    const auto join_item = R"({"userName":"dog","mapId":"map1"})"sv;
+
+    WHEN("several players join in one request") {
+        const auto resp = api.Response(MakePost("/api/v1/game/join/batch",
+                R"([{"userName":"a","mapId":"map1"},{"userName":"b","mapId":"map1"}])"));
+
+        THEN("every player gets an id and a token in the request order") {
+            REQUIRE(resp.result() == http::status::ok);
+            const auto joined = boost::json::parse(resp.body()).as_array();
+            REQUIRE(joined.size() == 2);
+            CHECK(joined.at(0).at("playerId").to_number<uint64_t>() == 0);
+            CHECK(joined.at(1).at("playerId").to_number<uint64_t>() == 1);
+            CHECK(env.app.GetPlayer(joined.at(1).at("authToken").as_string()).has_value());
+        }
+    }
+
+    WHEN("one of the maps is unknown") {
+        const auto resp = api.Response(MakePost("/api/v1/game/join/batch",
+                R"([{"userName":"a","mapId":"map1"},{"userName":"b","mapId":"map2"}])"));
+
+        THEN("nobody joins") {
+            CHECK(resp.result() == http::status::not_found);
+            CHECK(env.app.GetPlayers().GetPlayers().empty());
+        }
+    }
+
+    WHEN("the batch is exactly at the limit") {
+        const auto resp = api.Response(MakePost("/api/v1/game/join/batch", RepeatJson(join_item, MAX_BATCH_JOINS)));
+
+        THEN("it is accepted") {
+            CHECK(resp.result() == http::status::ok);
+            CHECK(env.app.GetPlayers().GetPlayers().size() == MAX_BATCH_JOINS);
+        }
+    }
+
+    WHEN("the batch is over the limit") {
+        const auto resp = api.Response(MakePost("/api/v1/game/join/batch", RepeatJson(join_item, MAX_BATCH_JOINS + 1)));
+
+        THEN("it is rejected as a whole") {
+            CHECK(resp.result() == http::status::bad_request);
+            CHECK(env.app.GetPlayers().GetPlayers().empty());
+        }
+    }
+}
+
+SCENARIO("Batch player actions", "[handler][batch]") {
+    HandlerEnv env;
+    http_handler::APIHandler api{env.app, net::make_strand(env.ioc)};
+    constexpr size_t MAX_BATCH_ACTIONS = 100'000;
+    const auto map = env.app.GetGame()->FindMap(model::Map::Id{"map1"});
+    REQUIRE(map);
+    const auto token = env.app.JoinGame("dog", *map).second;
+    const auto input = (*env.app.GetPlayer(token))->GetInput();
+    REQUIRE(input);
+    const std::string action_item = R"({"token":")" + token + R"(","move":"L"})";
+
+    WHEN("some actions have unknown tokens") {
+        const auto resp = api.Response(MakePost("/api/v1/game/player/actions",
+                "[" + action_item + R"(,{"token":"00000000000000000000000000000000","move":"R"},)" + action_item + "]"));
+
+        THEN("known ones are applied and unknown ones are reported by index") {
+            REQUIRE(resp.result() == http::status::ok);
+            CHECK(boost::json::parse(resp.body()) == boost::json::parse(R"({"applied":2,"rejected":[1]})"));
+            CHECK(input->GetSequence() == 2);
+        }
+    }
+
+    WHEN("one of the actions has an invalid direction") {
+        const auto resp = api.Response(MakePost("/api/v1/game/player/actions",
+                "[" + action_item + R"(,{"token":")" + token + R"(","move":"X"}])"));
+
+        THEN("no action is applied") {
+            CHECK(resp.result() == http::status::bad_request);
+            CHECK(input->GetSequence() == 0);
+        }
+    }
+
+    WHEN("the batch is exactly at the limit") {
+        const auto resp = api.Response(MakePost("/api/v1/game/player/actions", RepeatJson(action_item, MAX_BATCH_ACTIONS)));
+
+        THEN("every action is applied") {
+            REQUIRE(resp.result() == http::status::ok);
+            CHECK(boost::json::parse(resp.body()).at("applied").to_number<size_t>() == MAX_BATCH_ACTIONS);
+            CHECK(input->GetSequence() == MAX_BATCH_ACTIONS);
+        }
+    }
+
+    WHEN("the batch is over the limit") {
+        const auto resp = api.Response(MakePost("/api/v1/game/player/actions", RepeatJson(action_item, MAX_BATCH_ACTIONS + 1)));
+
+        THEN("it is rejected as a whole") {
+            CHECK(resp.result() == http::status::bad_request);
+            CHECK(input->GetSequence() == 0);
+        }
+    }
+}
@@ -1,9 +1,18 @@
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 
+#include "../src/config_cache.h"
+#include "../src/flat_snapshot.h"
+#include "../src/infrastructure.h"
+#include "../src/loot.h"
 #include "../src/model.h"
+#include "../src/record_log.h"
 #include "../src/serialization.h"
 
 using namespace model;
@@ -69,3 +78,300 @@ SCENARIO_METHOD(Fixture, "Dog Serialization") {
         }
     }
 }
+
+SCENARIO("Dog serialization in a binary archive") {
+    GIVEN("a dog") {
+        Dog dog{7, "Rex"s, {1.5, 2.5}, 2};
+        dog.AddScore(10);
+        CHECK(dog.PutToBag(CargoItem{3u, 1u}));
+
+        WHEN("dog is written to a binary archive") {
+            std::stringstream strm;
+            {
+                boost::archive::binary_oarchive output_archive{strm};
+                serialization::DogRepr repr{dog};
+                output_archive << repr;
+            }
+
+            THEN("it is read back unchanged") {
+                boost::archive::binary_iarchive input_archive{strm};
+                serialization::DogRepr repr;
+                input_archive >> repr;
+                const auto restored = repr.Restore();
+
+                CHECK(dog.GetIdValue() == restored.GetIdValue());
+                CHECK(dog.GetName() == restored.GetName());
+                CHECK(dog.GetPosition() == restored.GetPosition());
+                CHECK(dog.GetScore() == restored.GetScore());
+                CHECK(dog.GetBagContent() == restored.GetBagContent());
+            }
+        }
+    }
+}
+
+SCENARIO("Flat snapshot") {
+    GIVEN("a game with a session, loot and a player") {
+        auto make_game = [] {
+            auto game = std::make_shared<Game>();
+            game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+            Map map{Map::Id{"map1"}, "Map 1"};
+            map.AddRoad(Road{{0, 0}, {0, 10}});
+            game->AddMap(map);
+            game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+            return game;
+        };
+        auto game = make_game();
+        auto session = game->GetSession(*game->FindMap(Map::Id{"map1"}));
+
+        Dog dog{3, "Rex"s, {0.5, 2.5}, 2};
+        dog.SetSpeed({0.0, 1.0});
+        dog.SetDirection(Direction::SOUTH);
+        dog.AddScore(15);
+        dog.AddPlayTime(12s);
+        dog.SetLastActive(-1500ms);
+        CHECK(dog.PutToBag(CargoItem{4u, 1u}));
+        session->AddDog(dog);
+        session->UpsertLoot(LootItem{5, 1, {0.0, 7.0}});
+
+        app::Players players;
+        players.Add("Rex", GameSession::Id{session->GetIdValue()}, 3, "0123456789abcdef0123456789abcdef"s);
+        // Сессии с большими id были удалены
+        game->SetNextSessionId(10);
+
+        const auto path = std::filesystem::temp_directory_path() / "flat_snapshot_test.bin";
+        serialization::FlatSnapshot::Write(serialization::AppRepr{game, players, 7}, path);
+
+        WHEN("the snapshot is loaded into an empty game") {
+            REQUIRE(serialization::FlatSnapshot::Detect(path));
+            auto restored_game = make_game();
+            auto loaded = serialization::FlatSnapshot::Load(path, restored_game);
+
+            THEN("the state, play time and inactivity time are restored") {
+                CHECK(loaded.journal_segment == 7);
+                CHECK(restored_game->GetNextSessionId() == 10);
+                auto restored_session = restored_game->FindSession(GameSession::Id{session->GetIdValue()});
+                REQUIRE(restored_session != nullptr);
+                const auto dogs = restored_session->GetDogs();
+                REQUIRE(dogs.size() == 1);
+                const auto& restored = dogs.front();
+                CHECK(restored.GetName() == "Rex");
+                CHECK(restored.GetPosition() == dog.GetPosition());
+                CHECK(restored.GetSpeed() == dog.GetSpeed());
+                CHECK(restored.GetDirection() == Direction::SOUTH);
+                CHECK(restored.GetScore() == 15);
+                CHECK(restored.GetPlayTime() == 12s);
+                CHECK(restored_session->GetNonactiveTime(restored) == 1500ms);
+                CHECK(restored.GetBagContent() == dog.GetBagContent());
+                CHECK(restored_session->GetLoots().size() == 1);
+
+                auto player = loaded.players.GetPlayer("0123456789abcdef0123456789abcdef");
+                REQUIRE(player.has_value());
+                CHECK((*player)->GetIdValue() == 3);
+                CHECK((*player)->GetDogName() == "Rex");
+            }
+        }
+
+        WHEN("the snapshot is corrupted") {
+            {
+                std::fstream file{path, std::ios::in | std::ios::out | std::ios::binary};
+                file.seekp(-1, std::ios::end);
+                file.put('\x7f');
+            }
+
+            THEN("loading fails instead of restoring garbage") {
+                CHECK_THROWS(serialization::FlatSnapshot::Load(path, make_game()));
+            }
+        }
+
+        WHEN("a later session of the snapshot cannot be restored") {
+            auto game_with_two_maps = make_game();
+            Map map{Map::Id{"map2"}, "Map 2"};
+            map.AddRoad(Road{{0, 0}, {10, 0}});
+            game_with_two_maps->AddMap(map);
+            game_with_two_maps->SetLootData({{Map::Id{"map1"}, loot::MapLootTypes{{"key", "", ""}}},
+                                             {map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+            game_with_two_maps->GetSession(*game_with_two_maps->FindMap(Map::Id{"map1"}))->AddDog(0, "Rex");
+            game_with_two_maps->GetSession(*game_with_two_maps->FindMap(map.GetId()))->AddDog(1, "Max");
+            serialization::FlatSnapshot::Write(serialization::AppRepr{game_with_two_maps, players, 7}, path);
+
+            THEN("the game gets none of its sessions") {
+                // В этой игре нет второй карты
+                auto restored_game = make_game();
+                CHECK_THROWS(serialization::FlatSnapshot::Load(path, restored_game));
+                CHECK(restored_game->GetSessions().empty());
+                CHECK(restored_game->GetNextSessionId() == 0);
+            }
+        }
+
+        WHEN("the state changes after the session and players snapshots are taken") {
+            const auto session_snapshot = session->GetSnapshot();
+            const auto players_snapshot = players.GetSnapshot();
+            session->RemoveDog(3);
+            session->UpsertLoot(LootItem{6, 0, {0.0, 9.0}});
+            players.Add("Max", GameSession::Id{session->GetIdValue()});
+            serialization::FlatSnapshot::Write(serialization::AppRepr{{session_snapshot}, *players_snapshot, 8, game->GetNextSessionId()}, path);
+
+            THEN("the session and players change, the snapshots do not") {
+                CHECK(session->GetDogs().empty());
+                CHECK(session->GetLoots().size() == 2);
+                REQUIRE(session_snapshot.dogs->size() == 1);
+                CHECK(session_snapshot.dogs->front().GetName() == "Rex");
+                CHECK(session_snapshot.loots->size() == 1);
+                CHECK(players_snapshot->size() == 1);
+                CHECK(players.GetPlayers().size() == 2);
+            }
+
+            THEN("a flat snapshot built from them holds the state at capture time") {
+                auto restored_game = make_game();
+                auto loaded = serialization::FlatSnapshot::Load(path, restored_game);
+                CHECK(loaded.journal_segment == 8);
+                auto restored_session = restored_game->FindSession(GameSession::Id{session->GetIdValue()});
+                REQUIRE(restored_session != nullptr);
+                REQUIRE(restored_session->GetDogs().size() == 1);
+                const auto& restored = restored_session->GetDogs().front();
+                CHECK(restored.GetPosition() == dog.GetPosition());
+                CHECK(restored.GetScore() == 15);
+                CHECK(restored_session->GetNonactiveTime(restored) == 1500ms);
+                CHECK(restored_session->GetLoots().size() == 1);
+                CHECK(loaded.players.GetPlayers().size() == 1);
+            }
+        }
+
+        std::filesystem::remove(path);
+    }
+}
+
+SCENARIO("Autosave restore") {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "autosave_restore_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const fs::path state_path = dir / "state.bin";
+    const fs::path segment_path = dir / "state.bin.journal.0";
+
+    GIVEN("a damaged checkpoint and a journal segment after it") {
+        auto make_game = [] {
+            auto game = std::make_shared<Game>();
+            game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+            Map map{Map::Id{"map1"}, "Map 1"};
+            map.AddRoad(Road{{0, 0}, {0, 10}});
+            game->AddMap(map);
+            game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+            return game;
+        };
+        auto saved_game = make_game();
+        saved_game->GetSession(*saved_game->FindMap(Map::Id{"map1"}))->AddDog(0, "Rex");
+        serialization::FlatSnapshot::Write(serialization::AppRepr{saved_game, app::Players{}, 0}, state_path);
+        {
+            std::fstream file{state_path, std::ios::in | std::ios::out | std::ios::binary};
+            file.seekp(-1, std::ios::end);
+            file.put('\x7f');
+        }
+        std::ofstream{segment_path, std::ios::binary} << "journal frames";
+
+        auto read_file = [](const fs::path& path) {
+            std::ifstream file{path, std::ios::binary};
+            return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        };
+        const auto state_before = read_file(state_path);
+        const auto segment_before = read_file(segment_path);
+
+        WHEN("the autosaver restores the state on startup") {
+            db::EmbeddedRecordStore store{dir / "records.log"};
+            db::RecordLog spool{dir / "spool.log"};
+            db::RecordWriter writer{store, spool, {}};
+            bool failed = false;
+            {
+                app::App application{make_game(), store, writer};
+                infrastructure::Autosaver autosaver{application, state_path.string(), 10ms, true};
+                try {
+                    autosaver.Restore();
+                } catch (const std::exception&) {
+                    failed = true;
+                }
+            }
+
+            THEN("startup fails and the checkpoint and the journal are left as they were") {
+                CHECK(failed);
+                CHECK(read_file(state_path) == state_before);
+                REQUIRE(fs::exists(segment_path));
+                CHECK(read_file(segment_path) == segment_before);
+            }
+        }
+    }
+
+    fs::remove_all(dir);
+}
+
+SCENARIO("Compiled config cache") {
+    GIVEN("a game built from a config") {
+        auto game = std::make_shared<Game>();
+        json_loader::GameSettings settings{2.5, 4, 5000, 0.5, 15.0};
+        settings.ApplyTo(*game);
+        Map map{Map::Id{"map1"}, "Map 1"};
+        map.SetSpeed(3.0);
+        map.SetBagSize(2);
+        map.SetViewRadius(12.5);
+        map.AddRoad(Road{{0, 0}, {40, 0}});
+        map.AddRoad(Road{{40, 0}, {40, 30}});
+        map.AddBuilding(Building{Rectangle{{5, 5}, {30, 20}}});
+        map.AddOffice(Office{Office::Id{"o0"}, {40, 30}, {5, 0}});
+        game->AddMap(map);
+        loot::LootType key{"key", "assets/key.obj", "obj", 90, "#338844", 0.03, 10};
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{key}}});
+
+        const auto path = std::filesystem::temp_directory_path() / "config_cache_test.bin";
+        const json_loader::ConfigCache::Key config_key{1234, 0xdeadbeef};
+        json_loader::ConfigCache::Write(path, config_key, settings, *game);
+
+        WHEN("the cache is loaded with the same key") {
+            auto cached = json_loader::ConfigCache::Load(path, config_key);
+
+            THEN("settings, maps and loot types are restored") {
+                REQUIRE(cached);
+                CHECK(cached->GetDefaultSpeed() == 2.5);
+                CHECK(cached->GetDefaultBagSize() == 4);
+                CHECK(cached->GetRetirementTime() == 15s);
+                auto restored = cached->FindMap(Map::Id{"map1"});
+                REQUIRE(restored);
+                CHECK(restored->GetName() == "Map 1");
+                CHECK(restored->GetSpeed() == 3.0);
+                CHECK(restored->GetBagSize() == 2);
+                CHECK(restored->GetViewRadius() == 12.5);
+                CHECK(restored->GetRoads() == map.GetRoads());
+                REQUIRE(restored->GetBuildings().size() == 1);
+                CHECK(restored->GetBuildings().front().GetBounds().size.height == 20);
+                REQUIRE(restored->GetOffices().size() == 1);
+                CHECK(*restored->GetOffices().front().GetId() == "o0");
+                CHECK(restored->GetOffices().front().GetOffset().dx == 5);
+                CHECK_FALSE(restored->GetSpawns().IsEmpty());
+                const auto loots = cached->GetLootData(map.GetId());
+                REQUIRE(loots.size() == 1);
+                CHECK(loots.front().file == key.file);
+                CHECK(loots.front().rotation == key.rotation);
+                CHECK(loots.front().color == key.color);
+                CHECK(loots.front().scale == key.scale);
+                CHECK(loots.front().value == key.value);
+            }
+        }
+
+        WHEN("the config has changed") {
+            THEN("the cache is a miss") {
+                CHECK(json_loader::ConfigCache::Load(path, {1234, 0xfeedbeef}) == nullptr);
+            }
+        }
+
+        WHEN("the cache body is damaged") {
+            {
+                std::fstream file{path, std::ios::in | std::ios::out | std::ios::binary};
+                file.seekp(-1, std::ios::end);
+                file.put('\x7f');
+            }
+
+            THEN("loading fails") {
+                CHECK_THROWS(json_loader::ConfigCache::Load(path, config_key));
+            }
+        }
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,311 @@
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <boost/json.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/model.h"
+#include "../src/model_json.h"
+#include "../src/state_writer.h"
+
+using namespace std::literals;
+
+namespace {
+
+std::string JsonDouble(double value) {
+    std::string out;
+    model::AppendJsonDouble(out, value);
+    return out;
+}
+
+// Прежний способ: дерево json::value из GameState
+std::string SerializeThroughDom(const model::GameSession& session) {
+    model::GameState state;
+    for (const auto& dog : session.GetDogs()) {
+        state.actors.emplace(std::to_string(dog.GetIdValue()), dog);
+    }
+    for (const auto& [id, loot] : session.GetLoots()) {
+        state.loots.emplace(std::to_string(id), loot);
+    }
+    return boost::json::serialize(boost::json::value_from(state));
+}
+
+}  // namespace
+
+SCENARIO("Streaming game state writer", "[state]") {
+    GIVEN("doubles of different magnitudes") {
+        THEN("they are written the way Boost.JSON writes them") {
+            CHECK(JsonDouble(0.0) == "0E0");
+            CHECK(JsonDouble(1.0) == "1E0");
+            CHECK(JsonDouble(12.5) == "1.25E1");
+            CHECK(JsonDouble(-0.5) == "-5E-1");
+            CHECK(JsonDouble(0.1) == "1E-1");
+            CHECK(JsonDouble(1e-7) == "1E-7");
+            CHECK(JsonDouble(123456789.125) == "1.23456789125E8");
+            CHECK(JsonDouble(1e300) == "1E300");
+        }
+    }
+
+    GIVEN("a session with dogs, bags and loot") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"map1"}, "Map 1"};
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}, {"wallet", "", ""}}}});
+        auto session = game->GetSession(map);
+
+        // Id 2 и 10 проверяют строковый порядок ключей
+        for (uint64_t id : {2u, 10u, 1u}) {
+            model::Dog dog{id, "dog", {0.1 * static_cast<double>(id), 7.25}, 3};
+            dog.SetSpeed({0.0, -1.5});
+            dog.SetDirection(id == 1 ? model::Direction::NONE : model::Direction::SOUTH);
+            dog.AddScore(static_cast<unsigned>(id * 10));
+            if (id == 10) {
+                CHECK(dog.PutToBag({3, 1}));
+                CHECK(dog.PutToBag({4, 0}));
+            }
+            session->AddDog(dog);
+        }
+        session->UpsertLoot({12, 1, {0.0, 3.3333333333333335}});
+        session->UpsertLoot({9, 0, {0.0, 1e-3}});
+
+        WHEN("the state is written") {
+            std::string out;
+            model::WriteGameState(*session, out);
+
+            THEN("it matches the DOM serialization byte for byte") {
+                CHECK(out == SerializeThroughDom(*session));
+            }
+        }
+
+        WHEN("the session is empty") {
+            auto empty = game->GetSession(map);
+            for (uint64_t id : {2u, 10u, 1u}) {
+                empty->RemoveDog(id);
+            }
+            empty->RemoveLoot(12);
+            empty->RemoveLoot(9);
+            std::string out;
+            model::WriteGameState(*empty, out);
+
+            THEN("both containers are empty objects") {
+                CHECK(out == R"({"players":{},"lostObjects":{}})");
+            }
+        }
+    }
+}
+
+SCENARIO("Game state changes for long polling", "[state]") {
+    GIVEN("a session that has ticked once") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"map1"}, "Map 1"};
+        map.AddRoad(model::Road{{0, 0}, {0, 10}});
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+        auto session = game->GetSession(map);
+        session->AddDog(model::Dog{1, "dog", {0.0, 1.0}, 3});
+        session->AddDog(model::Dog{2, "dog", {0.0, 2.0}, 3});
+        session->UpsertLoot({7, 0, {0.0, 5.0}});
+        session->CloseVersion();
+        const auto version = session->GetVersion();
+
+        WHEN("a client without a version asks") {
+            std::string out;
+            model::WriteGameStateChanges(*session, 1, 0, out);
+
+            THEN("it gets the full state with the current version") {
+                std::string full;
+                model::WriteGameState(*session, full);
+                full.pop_back();
+                CHECK(out == full + R"(,"version":)" + std::to_string(version) + R"(,"full":true})");
+            }
+        }
+
+        WHEN("one dog moves and one loot is picked up") {
+            session->UpsertDog(model::Dog{2, "dog", {0.0, 2.5}, 3});
+            session->RemoveLoot(7);
+            session->CloseVersion();
+            std::string out;
+            model::WriteGameStateChanges(*session, 1, version, out);
+
+            THEN("only the changes are sent") {
+                std::string moved;
+                model::WriteGameState(*session, moved);
+                CHECK(out.starts_with(R"({"players":{"2":)"));
+                CHECK(out.find(R"("1":)") == std::string::npos);
+                CHECK(out.find(R"("lostObjects":{},"removedPlayers":[],"removedObjects":[7],)") != std::string::npos);
+                CHECK(out.ends_with(R"("version":)" + std::to_string(version + 1) + R"(,"full":false})"));
+            }
+        }
+
+        WHEN("nothing changed since the version") {
+            std::string out;
+            model::WriteGameStateChanges(*session, 1, version, out);
+
+            THEN("the delta is empty") {
+                CHECK(out == R"({"players":{},"lostObjects":{},"removedPlayers":[],"removedObjects":[],"version":)"
+                             + std::to_string(version) + R"(,"full":false})");
+            }
+        }
+
+        WHEN("the version is unknown to the session") {
+            std::string out;
+            model::WriteGameStateChanges(*session, 1, version + 100, out);
+
+            THEN("the full state is sent") {
+                CHECK(out.ends_with(R"(,"full":true})"));
+                CHECK(out.find(R"("1":)") != std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("Area of interest filtering", "[state]") {
+    GIVEN("a map with a view radius and dogs spread along a road") {
+        auto game = std::make_shared<model::Game>();
+        game->SetLootGenerator(std::make_shared<loot::LootGenerator>(1s, 0.0));
+        model::Map map{model::Map::Id{"map1"}, "Map 1"};
+        map.AddRoad(model::Road{{0, 0}, {100, 0}});
+        map.SetViewRadius(10.0);
+        game->AddMap(map);
+        game->SetLootData({{map.GetId(), loot::MapLootTypes{{"key", "", ""}}}});
+        auto session = game->GetSession(map);
+        session->AddDog(model::Dog{1, "near", {0.0, 0.0}, 3});
+        session->AddDog(model::Dog{2, "edge", {10.0, 0.0}, 3});
+        session->AddDog(model::Dog{3, "far", {50.0, 0.0}, 3});
+        session->UpsertLoot({7, 0, {5.0, 0.0}});
+        session->UpsertLoot({8, 0, {60.0, 0.0}});
+
+        WHEN("no tick has built the grid yet") {
+            std::string filtered;
+            model::WriteGameState(*session, 1, filtered);
+
+            THEN("the whole session is visible") {
+                std::string full;
+                model::WriteGameState(*session, full);
+                CHECK(filtered == full);
+            }
+        }
+
+        WHEN("the session has ticked") {
+            session->Tick(0.0);
+            REQUIRE(session->GetInterestGrids());
+
+            THEN("a player sees only what is within the radius") {
+                std::string out;
+                model::WriteGameState(*session, 1, out);
+                CHECK(out.find(R"("1":)") != std::string::npos);
+                CHECK(out.find(R"("2":)") != std::string::npos);
+                CHECK(out.find(R"("3":)") == std::string::npos);
+                CHECK(out.find(R"("7":)") != std::string::npos);
+                CHECK(out.find(R"("8":)") == std::string::npos);
+            }
+
+            THEN("a dog that joined after the tick sees at least itself") {
+                session->AddDog(model::Dog{4, "late", {90.0, 0.0}, 3});
+                std::string out;
+                model::WriteGameState(*session, 4, out);
+                CHECK(out == R"({"players":{"4":{"pos":[9E1,0E0],"speed":[0E0,0E0],"dir":"","bag":[],"score":0}},"lostObjects":{}})");
+            }
+
+            THEN("long polling gets the full state filtered the same way, even for a known version") {
+                for (uint64_t since : {uint64_t{0}, session->GetVersion(), session->GetVersion() + 100}) {
+                    std::string filtered;
+                    model::WriteGameState(*session, 1, filtered);
+                    filtered.pop_back();
+                    std::string out;
+                    model::WriteGameStateChanges(*session, 1, since, out);
+                    CHECK(out == filtered + R"(,"version":)" + std::to_string(session->GetVersion()) + R"(,"full":true})");
+                    CHECK(out.find(R"("3":)") == std::string::npos);
+                }
+            }
+
+            THEN("changes out of view are not sent and objects that left it are dropped by the full state") {
+                const auto since = session->GetVersion();
+                session->UpsertLoot({9, 0, {70.0, 0.0}});
+                session->RemoveDog(2);
+                session->Tick(0.0);
+                std::string out;
+                model::WriteGameStateChanges(*session, 1, since, out);
+                CHECK(out.ends_with(R"(,"full":true})"));
+                CHECK(out.find(R"("2":)") == std::string::npos);
+                CHECK(out.find(R"("9":)") == std::string::npos);
+                CHECK(out.find(R"("7":)") != std::string::npos);
+            }
+
+            THEN("a dog that left after the tick is not shown") {
+                session->RemoveDog(2);
+                std::string out;
+                model::WriteGameState(*session, 1, out);
+                CHECK(out.find(R"("2":)") == std::string::npos);
+            }
+        }
+    }
+}
+
+SCENARIO("Spatial grid", "[state]") {
+    GIVEN("points on a grid, including far outliers") {
+        std::vector<model::SpatialGrid::Entry> entries;
+        uint64_t id = 0;
+        for (int x = 0; x < 20; ++x) {
+            for (int y = 0; y < 20; ++y) {
+                entries.push_back({{static_cast<double>(x), static_cast<double>(y)}, id++});
+            }
+        }
+        entries.push_back({{1e6, -1e6}, id++});
+        model::SpatialGrid grid;
+        grid.Build(entries, 3.0);
+
+        THEN("a radius query finds exactly the points within it") {
+            for (const model::Point2D center : {model::Point2D{5.5, 5.5}, model::Point2D{0, 0}, model::Point2D{-4, 25}}) {
+                std::set<uint64_t> found;
+                grid.ForEachInRadius(center, 3.0, [&found](uint64_t found_id) {
+                    CHECK(found.insert(found_id).second);
+                });
+                std::set<uint64_t> expected;
+                for (const auto& entry : entries) {
+                    const double dx = entry.pos.x - center.x;
+                    const double dy = entry.pos.y - center.y;
+                    if (dx * dx + dy * dy <= 9.0) {
+                        expected.insert(entry.id);
+                    }
+                }
+                CHECK(found == expected);
+            }
+            CHECK(grid.Size() == entries.size());
+        }
+    }
+
+    GIVEN("points on a single row") {
+        model::SpatialGrid grid;
+        grid.Build({{{0.0, 0.0}, 1}, {{5.0, 0.0}, 2}, {{10.0, 0.0}, 3}}, 1.0);
+
+        THEN("a negative or NaN radius finds nothing") {
+            size_t found = 0;
+            const auto count = [&found](uint64_t) { ++found; };
+            grid.ForEachInRadius({5.0, 0.0}, -3.0, count);
+            grid.ForEachInRadius({5.0, 0.0}, std::numeric_limits<double>::quiet_NaN(), count);
+            CHECK(found == 0);
+        }
+    }
+}
+
+SCENARIO("View radius validation", "[state]") {
+    GIVEN("a map") {
+        model::Map map{model::Map::Id{"map1"}, "Map 1"};
+
+        THEN("only a positive finite radius is accepted") {
+            CHECK_NOTHROW(map.SetViewRadius(2.5));
+            CHECK_NOTHROW(map.SetViewRadius(std::nullopt));
+            CHECK_THROWS_AS(map.SetViewRadius(0.0), std::invalid_argument);
+            CHECK_THROWS_AS(map.SetViewRadius(-1.0), std::invalid_argument);
+            CHECK_THROWS_AS(map.SetViewRadius(std::numeric_limits<double>::infinity()), std::invalid_argument);
+            CHECK_THROWS_AS(map.SetViewRadius(std::numeric_limits<double>::quiet_NaN()), std::invalid_argument);
+            CHECK_FALSE(map.GetViewRadius());
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/tick_pipeline.h"
+
+using namespace std::literals;
+using Mode = model::TickPipeline::Mode;
+
+SCENARIO("Tick pipeline", "[tick]") {
+    GIVEN("A pipeline") {
+        model::TickPipeline pipeline;
+        std::mutex mutex;
+        std::vector<std::string> calls;
+        auto record = [&](std::string name) {
+            return [&, name](std::chrono::milliseconds) {
+                std::lock_guard lock{mutex};
+                calls.push_back(name);
+            };
+        };
+
+        WHEN("stages are added out of dependency order") {
+            pipeline.AddStage("save", record("save"), Mode::INLINE, {"retire"});
+            pipeline.AddStage("retire", record("retire"));
+            pipeline.Run(100ms);
+
+            THEN("dependencies run first") {
+                CHECK(calls == std::vector<std::string>{"retire", "save"});
+            }
+        }
+
+        WHEN("parallel stages share a level") {
+            std::atomic<int> parallel_calls{0};
+            pipeline.AddStage("a", [&](std::chrono::milliseconds) { ++parallel_calls; }, Mode::PARALLEL);
+            pipeline.AddStage("b", [&](std::chrono::milliseconds) { ++parallel_calls; }, Mode::PARALLEL);
+            pipeline.AddStage("after", record("after"), Mode::INLINE, {"a", "b"});
+            pipeline.Run(100ms);
+
+            THEN("the tick waits for all of them before the next level") {
+                CHECK(parallel_calls == 2);
+                CHECK(calls == std::vector<std::string>{"after"});
+            }
+        }
+
+        WHEN("a background stage is added") {
+            std::atomic<long> total{0};
+            pipeline.AddStage("report", [&](std::chrono::milliseconds delta) { total += delta.count(); }, Mode::BACKGROUND);
+            pipeline.Run(100ms);
+            pipeline.Run(50ms);
+            pipeline.Stop();
+
+            THEN("it receives the time of every tick, possibly coalesced") {
+                CHECK(total == 150);
+            }
+        }
+
+        WHEN("a stage throws") {
+            pipeline.AddStage("broken", [](std::chrono::milliseconds) { throw std::runtime_error("boom"); });
+            pipeline.AddStage("next", record("next"), Mode::INLINE, {"broken"});
+
+            THEN("the other stages still run") {
+                CHECK_NOTHROW(pipeline.Run(100ms));
+                CHECK(calls == std::vector<std::string>{"next"});
+            }
+        }
+
+        WHEN("stages form a cycle") {
+            pipeline.AddStage("a", record("a"), Mode::INLINE, {"b"});
+            pipeline.AddStage("b", record("b"), Mode::INLINE, {"a"});
+
+            THEN("the pipeline refuses to run") {
+                CHECK_THROWS_AS(pipeline.Run(100ms), std::logic_error);
+            }
+        }
+
+        THEN("stage names are unique") {
+            pipeline.AddStage("retire", record("retire"));
+            CHECK_THROWS_AS(pipeline.AddStage("retire", record("retire")), std::invalid_argument);
+        }
+    }
+}
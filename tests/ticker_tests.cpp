@@ -0,0 +1,154 @@
+#include <chrono>
+#include <numeric>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/ticker.h"
+
+using namespace std::literals;
+
+namespace {
+
+// Часы, которые идут только по команде теста
+struct ManualClock {
+    using duration = std::chrono::steady_clock::duration;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<ManualClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept {
+        return current;
+    }
+
+    inline static time_point current{};
+};
+
+}  // namespace
+
+// Реактор не должен спать по реальным часам: истёкшие по ManualClock таймеры проверяются сразу
+template <>
+struct boost::asio::wait_traits<ManualClock> {
+    static ManualClock::duration to_wait_duration(const ManualClock::duration&) {
+        return ManualClock::duration::zero();
+    }
+    static ManualClock::duration to_wait_duration(const ManualClock::time_point&) {
+        return ManualClock::duration::zero();
+    }
+};
+
+namespace {
+
+struct TickerEnv {
+    explicit TickerEnv(CatchUpPolicy policy, unsigned max_substeps = 4) {
+        ManualClock::current = ManualClock::time_point{};
+        ticker = std::make_shared<BasicTicker<ManualClock>>(
+                strand, 10ms, [this](std::chrono::milliseconds delta) { deltas.push_back(delta); },
+                TickerOptions{policy, max_substeps});
+        ticker->Start();
+        ioc.poll();
+    }
+
+    // Переводит часы на offset от старта и выполняет всё, что стало готово
+    void RunAt(ManualClock::duration offset) {
+        ManualClock::current = ManualClock::time_point{} + offset;
+        ioc.restart();
+        ioc.poll();
+    }
+
+    [[nodiscard]] std::chrono::milliseconds Total() const {
+        return std::accumulate(deltas.begin(), deltas.end(), 0ms);
+    }
+
+    net::io_context ioc;
+    BasicTicker<ManualClock>::Strand strand = net::make_strand(ioc);
+    std::vector<std::chrono::milliseconds> deltas;
+    std::shared_ptr<BasicTicker<ManualClock>> ticker;
+};
+
+}  // namespace
+
+SCENARIO("Ticker catch-up policies", "[ticker]") {
+    GIVEN("a ticker with a 10 ms period") {
+        WHEN("the clock has not reached the first deadline") {
+            TickerEnv env{CatchUpPolicy::MERGE};
+            env.RunAt(9ms);
+
+            THEN("the handler is not called") {
+                CHECK(env.deltas.empty());
+            }
+        }
+
+        WHEN("ticks under MERGE come a fraction of a millisecond late") {
+            TickerEnv env{CatchUpPolicy::MERGE};
+            for (int tick = 1; tick <= 5; ++tick) {
+                env.RunAt(10400us * tick);
+            }
+
+            THEN("the truncated remainders are carried into later ticks") {
+                REQUIRE(env.deltas.size() == 5);
+                CHECK(env.deltas == std::vector{10ms, 10ms, 11ms, 10ms, 11ms});
+                CHECK(env.Total() == 52ms);
+            }
+        }
+
+        WHEN("a tick under MERGE wakes up after several missed periods") {
+            TickerEnv env{CatchUpPolicy::MERGE};
+            env.RunAt(35ms);
+
+            THEN("one call gets all the elapsed time") {
+                CHECK(env.deltas == std::vector{35ms});
+            }
+
+            THEN("the next deadline stays on the original schedule") {
+                env.RunAt(39ms);
+                CHECK(env.deltas.size() == 1);
+                env.RunAt(40ms);
+                CHECK(env.deltas == std::vector{35ms, 5ms});
+            }
+        }
+
+        WHEN("a tick under SKIP wakes up after several missed periods") {
+            TickerEnv env{CatchUpPolicy::SKIP};
+            env.RunAt(35ms);
+            env.RunAt(40ms);
+
+            THEN("each call gets one period and missed deadlines are dropped") {
+                CHECK(env.deltas == std::vector{10ms, 10ms});
+            }
+        }
+
+        WHEN("a tick under SUBSTEP wakes up after several missed periods") {
+            TickerEnv env{CatchUpPolicy::SUBSTEP};
+            env.RunAt(35ms);
+
+            THEN("every missed period gets its own call") {
+                CHECK(env.deltas == std::vector{10ms, 10ms, 10ms});
+            }
+
+            THEN("the next deadline follows the missed ones") {
+                env.RunAt(39ms);
+                CHECK(env.deltas.size() == 3);
+                env.RunAt(40ms);
+                CHECK(env.deltas.size() == 4);
+            }
+        }
+
+        WHEN("SUBSTEP falls behind more than max_substeps periods") {
+            TickerEnv env{CatchUpPolicy::SUBSTEP, 2};
+            env.RunAt(75ms);
+
+            THEN("the number of calls is capped") {
+                CHECK(env.deltas == std::vector{10ms, 10ms});
+            }
+
+            THEN("the schedule still skips every missed deadline") {
+                env.RunAt(79ms);
+                CHECK(env.deltas.size() == 2);
+                env.RunAt(80ms);
+                CHECK(env.deltas.size() == 3);
+            }
+        }
+    }
+}